@@ -105,9 +105,14 @@ static void __nvmev_admin_delete_cq(int eid)
 	qid = sq_entry(eid).delete_queue.qid;
 
 	cq = nvmev_vdev->cqes[qid];
-	nvmev_vdev->cqes[qid] = NULL;
+	WRITE_ONCE(nvmev_vdev->cqes[qid], NULL);
 
 	if (cq) {
+		// The owning dispatcher may still be walking this queue
+		if (nvmev_vdev->config.nr_dispatchers > 1)
+			synchronize_srcu(&nvmev_queue_srcu);
+
+
 		kfree(cq->cq);
 		if (cq->mapped)
 			memunmap(cq->mapped);
@@ -150,6 +155,7 @@ static void __nvmev_admin_create_sq(int eid)
 			sq->sq[i] = (void *)((uint64_t)sq->mapped + i * PAGE_SIZE);
 	}
 
+	NVMEV_IO_WORKER_MAP_SQ(sq->qid, nvmev_phys_to_node(cmd->prp1));
 	nvmev_vdev->sqes[sq->qid] = sq;
 
 	dbs_idx = sq->qid * 2;
@@ -169,9 +175,14 @@ static void __nvmev_admin_delete_sq(int eid)
 	qid = cmd->qid;
 
 	sq = nvmev_vdev->sqes[qid];
-	nvmev_vdev->sqes[qid] = NULL;
+	WRITE_ONCE(nvmev_vdev->sqes[qid], NULL);
 
 	if (sq) {
+		// The owning dispatcher may still be walking this queue
+		if (nvmev_vdev->config.nr_dispatchers > 1)
+			synchronize_srcu(&nvmev_queue_srcu);
+
+
 		kfree(sq->sq);
 		if (sq->mapped)
 			memunmap(sq->mapped);
@@ -426,7 +437,11 @@ static void __nvmev_admin_identify_ctrl(int eid)
 	memset(ctrl, 0x00, sizeof(*ctrl));
 
 	ctrl->nn = nvmev_vdev->nr_ns;
+#if SUPPORTED_SSD_TYPE(CONV)
+	ctrl->oncs = NVME_CTRL_ONCS_DSM | NVME_CTRL_ONCS_WRITE_ZEROES;
+#else
 	ctrl->oncs = 0; //optional command
+#endif
 	ctrl->acl = 3; //minimum 4 required, 0's based value
 	ctrl->vwc = 0;
 	snprintf(ctrl->sn, sizeof(ctrl->sn), "CSL_Virt_SN_%02d", 1);
@@ -479,6 +494,7 @@ static void __nvmev_admin_set_features(int eid)
 	struct nvme_features *cmd = &sq_entry(eid).features;
 	__le32 result0 = 0;
 	__le32 result1 = 0;
+	u16 status = NVME_SC_SUCCESS;
 
 	switch (cmd->fid) {
 	case NVME_FEAT_ARBITRATION:
@@ -503,7 +519,20 @@ static void __nvmev_admin_set_features(int eid)
 		break;
 	}
 	case NVME_FEAT_IRQ_COALESCE:
-	case NVME_FEAT_IRQ_CONFIG:
+		/* Applied by the IO workers on their next interrupt check */
+		WRITE_ONCE(nvmev_vdev->irq_coalesce_thr, cmd->dword11 & 0xFF);
+		WRITE_ONCE(nvmev_vdev->irq_coalesce_time, (cmd->dword11 >> 8) & 0xFF);
+		break;
+	case NVME_FEAT_IRQ_CONFIG: {
+		unsigned int iv = cmd->dword11 & 0xFFFF;
+
+		if (iv > NR_MAX_IO_QUEUE) {
+			status = NVME_SC_INVALID_FIELD;
+			break;
+		}
+		WRITE_ONCE(nvmev_vdev->irq_coalesce_disabled[iv], !!(cmd->dword11 & (1 << 16)));
+		break;
+	}
 	case NVME_FEAT_WRITE_ATOMIC:
 	case NVME_FEAT_ASYNC_EVENT:
 	case NVME_FEAT_AUTO_PST:
@@ -515,7 +544,7 @@ static void __nvmev_admin_set_features(int eid)
 		break;
 	}
 
-	__make_cq_entry_results(eid, NVME_SC_SUCCESS, result0, result1);
+	__make_cq_entry_results(eid, status, result0, result1);
 }
 
 static void __nvmev_admin_get_features(int eid)
@@ -524,6 +553,7 @@ static void __nvmev_admin_get_features(int eid)
 	struct nvme_features *cmd = &sq_entry(eid).features;
 	__le32 result0 = 0;
 	__le32 result1 = 0;
+	u16 status = NVME_SC_SUCCESS;
 
 	switch (cmd->fid) {
 	case NVME_FEAT_ARBITRATION:
@@ -537,7 +567,18 @@ static void __nvmev_admin_get_features(int eid)
 		result0 = ((nvmev_vdev->nr_cq - 1) << 16 | (nvmev_vdev->nr_sq - 1));
 		break;
 	case NVME_FEAT_IRQ_COALESCE:
-	case NVME_FEAT_IRQ_CONFIG:
+		result0 = nvmev_vdev->irq_coalesce_thr | (nvmev_vdev->irq_coalesce_time << 8);
+		break;
+	case NVME_FEAT_IRQ_CONFIG: {
+		unsigned int iv = cmd->dword11 & 0xFFFF;
+
+		if (iv > NR_MAX_IO_QUEUE) {
+			status = NVME_SC_INVALID_FIELD;
+			break;
+		}
+		result0 = iv | (nvmev_vdev->irq_coalesce_disabled[iv] << 16);
+		break;
+	}
 	case NVME_FEAT_WRITE_ATOMIC:
 	case NVME_FEAT_ASYNC_EVENT:
 	case NVME_FEAT_AUTO_PST:
@@ -549,7 +590,7 @@ static void __nvmev_admin_get_features(int eid)
 		break;
 	}
 
-	__make_cq_entry_results(eid, NVME_SC_SUCCESS, result0, result1);
+	__make_cq_entry_results(eid, status, result0, result1);
 }
 
 
@@ -4,17 +4,26 @@
 #include <linux/ktime.h>
 #include <linux/highmem.h>
 #include <linux/sched/clock.h>
+#include <linux/slab.h>
+#include <linux/moduleparam.h>
 
 #include "nvmev.h"
 #include "channel_model.h"
 
+static int chmodel = CHMODEL_CREDIT;
+module_param(chmodel, int, 0444);
+MODULE_PARM_DESC(chmodel, "Channel/PCIe bandwidth model (0: credit array, 1: reservation tree)");
+
 static inline unsigned long long __get_wallclock(void)
 {
 	return cpu_clock(nvmev_vdev->config.cpu_nr_dispatcher);
 }
 
-void chmodel_init(struct channel_model *ch, uint64_t bandwidth /*MB/s*/)
+int chmodel_init(struct channel_model *ch, uint64_t bandwidth /*MB/s*/)
 {
+	int i;
+
+	ch->type = (chmodel == CHMODEL_RESV) ? CHMODEL_RESV : CHMODEL_CREDIT;
 	ch->head = 0;
 	ch->valid_len = 0;
 	ch->cur_time = 0;
@@ -22,13 +31,40 @@ void chmodel_init(struct channel_model *ch, uint64_t bandwidth /*MB/s*/)
 	ch->command_credits = 0;
 	ch->xfer_lat = BANDWIDTH_TO_TX_TIME(bandwidth);
 
-	MEMSET(&(ch->avail_credits[0]), ch->max_credits, NR_CREDIT_ENTRIES);
+	ch->avail_credits = NULL;
+	ch->resv_root = RB_ROOT;
+	ch->resv_pool = NULL;
+	ch->resv_free = NULL;
+	ch->nr_resv = 0;
 
-	NVMEV_INFO("[%s] bandwidth %llu max_credits %u tx_time %u\n", __func__, bandwidth,
-		   ch->max_credits, ch->xfer_lat);
+	if (ch->type == CHMODEL_RESV) {
+		ch->resv_pool = kmalloc(sizeof(struct chmodel_resv) * NR_RESV_ENTRIES, GFP_KERNEL);
+		if (!ch->resv_pool)
+			return -ENOMEM;
+		for (i = 0; i < NR_RESV_ENTRIES; i++) {
+			ch->resv_pool[i].next_free = ch->resv_free;
+			ch->resv_free = &ch->resv_pool[i];
+		}
+	} else {
+		ch->avail_credits = kmalloc(sizeof(credit_t) * NR_CREDIT_ENTRIES, GFP_KERNEL);
+		if (!ch->avail_credits)
+			return -ENOMEM;
+		MEMSET(&(ch->avail_credits[0]), ch->max_credits, NR_CREDIT_ENTRIES);
+	}
+
+	NVMEV_INFO("[%s] %s bandwidth %llu max_credits %u tx_time %u\n", __func__,
+		   ch->type == CHMODEL_RESV ? "resv" : "credit", bandwidth, ch->max_credits,
+		   ch->xfer_lat);
+	return 0;
 }
 
-uint64_t chmodel_request(struct channel_model *ch, uint64_t request_time, uint64_t length)
+void chmodel_exit(struct channel_model *ch)
+{
+	kfree(ch->avail_credits);
+	kfree(ch->resv_pool);
+}
+
+static uint64_t __credit_request(struct channel_model *ch, uint64_t request_time, uint64_t length)
 {
 	uint64_t cur_time = __get_wallclock();
 	uint32_t pos, next_pos;
@@ -118,3 +154,151 @@ uint64_t chmodel_request(struct channel_model *ch, uint64_t request_time, uint64
 
 	return request_time + total_latency;
 }
+
+static struct chmodel_resv *__resv_alloc(struct channel_model *ch, uint64_t start)
+{
+	struct rb_node **link = &ch->resv_root.rb_node, *parent = NULL;
+	struct chmodel_resv *r = ch->resv_free;
+
+	if (!r)
+		return NULL;
+
+	ch->resv_free = r->next_free;
+	r->start = r->end = start;
+
+	while (*link) {
+		parent = *link;
+		if (start < rb_entry(parent, struct chmodel_resv, node)->start)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&r->node, parent, link);
+	rb_insert_color(&r->node, &ch->resv_root);
+	ch->nr_resv++;
+
+	return r;
+}
+
+static void __resv_free(struct channel_model *ch, struct chmodel_resv *r)
+{
+	rb_erase(&r->node, &ch->resv_root);
+	r->next_free = ch->resv_free;
+	ch->resv_free = r;
+	ch->nr_resv--;
+}
+
+/*
+ * Free an entry when the pool is exhausted by merging the two adjacent
+ * intervals with the smallest gap between them. Only that gap is marked
+ * busy, which is the least channel time any merge can over-reserve.
+ */
+static void __resv_coalesce(struct channel_model *ch)
+{
+	struct chmodel_resv *r, *next, *best = NULL;
+	uint64_t best_gap = U64_MAX;
+	struct rb_node *node;
+
+	for (node = rb_first(&ch->resv_root); node; node = rb_next(node)) {
+		r = rb_entry(node, struct chmodel_resv, node);
+		if (!rb_next(node))
+			break;
+		next = rb_entry(rb_next(node), struct chmodel_resv, node);
+		if (next->start - r->end < best_gap) {
+			best_gap = next->start - r->end;
+			best = r;
+		}
+	}
+
+	if (!best)
+		return;
+
+	next = rb_entry(rb_next(&best->node), struct chmodel_resv, node);
+	best->end = next->end;
+	__resv_free(ch, next);
+}
+
+/*
+ * Reserve the transfer in the earliest idle time at or after request_time.
+ * Like the credit array, a transfer may be split over several gaps left by
+ * reservations made for later times. Adjacent intervals are merged so the
+ * tree only holds one entry per gap, and intervals that ended before the
+ * wallclock are retired on every request.
+ */
+static uint64_t __resv_request(struct channel_model *ch, uint64_t request_time, uint64_t length)
+{
+	uint64_t cur_time = __get_wallclock();
+	uint64_t remaining = (uint64_t)ch->xfer_lat * DIV_ROUND_UP(length, UNIT_XFER_SIZE);
+	uint64_t t = request_time, gap;
+	struct chmodel_resv *r, *prev = NULL, *next, *cur = NULL;
+	struct rb_node *node;
+
+	while ((node = rb_first(&ch->resv_root))) {
+		r = rb_entry(node, struct chmodel_resv, node);
+		if (r->end > cur_time)
+			break;
+		__resv_free(ch, r);
+	}
+	ch->cur_time = cur_time;
+
+	if (!remaining)
+		return request_time;
+
+	// A request allocates at most one entry; make sure there is one
+	if (!ch->resv_free) {
+		NVMEV_DEBUG("[%s] No free entry 0x%llx 0x%llx\n", __func__, request_time, cur_time);
+		__resv_coalesce(ch);
+	}
+
+	// Find the last interval starting at or before the request time
+	node = ch->resv_root.rb_node;
+	while (node) {
+		r = rb_entry(node, struct chmodel_resv, node);
+		if (r->start <= t) {
+			prev = r;
+			node = node->rb_right;
+		} else {
+			node = node->rb_left;
+		}
+	}
+
+	if (prev && prev->end >= t) {
+		cur = prev;
+		t = prev->end;
+	}
+	node = prev ? rb_next(&prev->node) : rb_first(&ch->resv_root);
+
+	while (1) {
+		next = node ? rb_entry(node, struct chmodel_resv, node) : NULL;
+
+		if (!cur) {
+			cur = __resv_alloc(ch, t);
+			NVMEV_ASSERT(cur);
+		}
+
+		gap = next ? next->start - t : remaining;
+		if (gap >= remaining) {
+			cur->end = t + remaining;
+			if (next && cur->end == next->start) {
+				cur->end = next->end;
+				__resv_free(ch, next);
+			}
+			return t + remaining;
+		}
+
+		// Fill the gap and continue after the next interval
+		remaining -= gap;
+		cur->end = next->end;
+		__resv_free(ch, next);
+		t = cur->end;
+		node = rb_next(&cur->node);
+	}
+}
+
+uint64_t chmodel_request(struct channel_model *ch, uint64_t request_time, uint64_t length)
+{
+	if (ch->type == CHMODEL_RESV)
+		return __resv_request(ch, request_time, length);
+
+	return __credit_request(ch, request_time, length);
+}
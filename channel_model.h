@@ -3,6 +3,8 @@
 #ifndef _CHANNEL_MODEL_H
 #define _CHANNEL_MODEL_H
 
+#include <linux/rbtree.h>
+
 /* Macros for channel model */
 #define NR_CREDIT_ENTRIES (1024 * 96)
 #define UNIT_TIME_INTERVAL (4000ULL) //ns
@@ -26,7 +28,24 @@ typedef uint32_t credit_t;
 #error "Invalid credit size"
 #endif
 
+/* Bandwidth models selectable with the chmodel parameter */
+enum {
+	CHMODEL_CREDIT = 0, /* per-interval credit array with a fixed horizon */
+	CHMODEL_RESV = 1, /* tree of busy intervals, unbounded horizon */
+};
+
+#define NR_RESV_ENTRIES (256)
+
+/* A busy interval [start, end) of the channel */
+struct chmodel_resv {
+	struct rb_node node;
+	uint64_t start;
+	uint64_t end;
+	struct chmodel_resv *next_free;
+};
+
 struct channel_model {
+	int type;
 	uint64_t cur_time;
 	uint32_t head;
 	uint32_t valid_len;
@@ -34,7 +53,14 @@ struct channel_model {
 	uint32_t command_credits;
 	uint32_t xfer_lat; /*XKB NAND CH transfer time in nanoseconds*/
 
-	credit_t avail_credits[NR_CREDIT_ENTRIES];
+	/* CHMODEL_CREDIT */
+	credit_t *avail_credits;
+
+	/* CHMODEL_RESV */
+	struct rb_root resv_root;
+	struct chmodel_resv *resv_pool;
+	struct chmodel_resv *resv_free;
+	uint32_t nr_resv;
 };
 
 #define BANDWIDTH_TO_TX_TIME(MB_S) (((UNIT_XFER_SIZE)*NS_PER_SEC(1)) / (MB(MB_S)))
@@ -42,5 +68,6 @@ struct channel_model {
 	(MB(MB_S) * UNIT_TIME_INTERVAL / NS_PER_SEC(1) / UNIT_XFER_SIZE * UNIT_XFER_CREDITS)
 
 uint64_t chmodel_request(struct channel_model *ch, uint64_t request_time, uint64_t length);
-void chmodel_init(struct channel_model *ch, uint64_t bandwidth /*MB/s*/);
+int chmodel_init(struct channel_model *ch, uint64_t bandwidth /*MB/s*/);
+void chmodel_exit(struct channel_model *ch);
 #endif
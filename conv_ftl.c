@@ -6,6 +6,8 @@
 #include <linux/moduleparam.h> // 파라미터 사용을 위한 헤더
 #include <linux/random.h> // get_random_u32() 함수 사용을 위해 필수
 #include <linux/types.h>
+#include <linux/kthread.h>
+#include <linux/log2.h>
 
 #include "nvmev.h"      // NVMeVirt 공통 헤더
 #include "conv_ftl.h"   // Conventional FTL 헤더
@@ -17,30 +19,155 @@ static bool slc_buf = false;
 module_param(gc_mode, int, 0644);
 module_param(slc_buf, bool, 0644);
 
+// 백그라운드(유휴 시간) GC 설정
+static bool bg_gc = true;
+static unsigned int bg_gc_thres_lines = 8;    // 프리 라인이 이 이하이면 유휴 시간에 GC 시작
+static unsigned int bg_gc_interval_us = 1000; // 백그라운드 GC 라인 간 최소 간격 (스로틀링)
+static unsigned int bg_gc_idle_slack_us = 50; // LUN 대기 시간이 이 이하이면 '한가함'으로 간주
+
+module_param(bg_gc, bool, 0644);
+MODULE_PARM_DESC(bg_gc, "Enable idle-time background GC");
+module_param(bg_gc_thres_lines, uint, 0444);
+MODULE_PARM_DESC(bg_gc_thres_lines, "Free line count at or below which background GC runs");
+module_param(bg_gc_interval_us, uint, 0644);
+MODULE_PARM_DESC(bg_gc_interval_us, "Minimum interval between background GC victims in usec");
+module_param(bg_gc_idle_slack_us, uint, 0644);
+MODULE_PARM_DESC(bg_gc_idle_slack_us, "Max outstanding NAND work in usec for the device to count as idle");
+
+// 매핑 테이블을 32비트 엔트리로 압축 (지오메트리가 맞지 않으면 64비트로 폴백)
+static bool compact_map = true;
+module_param(compact_map, bool, 0444);
+MODULE_PARM_DESC(compact_map, "Use 32-bit maptbl/rmap entries when the geometry fits");
+
+// 유휴 시간 SLC->TLC 마이그레이션 (slc_buf 모드): 다음 버스트 전에 SLC 버퍼를 비워 둔다
+static bool bg_mg = true;
+static unsigned int bg_mg_free_pcent = 100; // 유휴 시간에 확보할 SLC 프리 라인 비율
+
+module_param(bg_mg, bool, 0644);
+MODULE_PARM_DESC(bg_mg, "Enable idle-time SLC to TLC migration");
+module_param(bg_mg_free_pcent, uint, 0444);
+MODULE_PARM_DESC(bg_mg_free_pcent, "Percentage of SLC lines idle-time migration keeps free");
+
+/*
+ * 동적 SLC 크기 (slc_buf 모드): 지워진 라인을 프리 리스트에 돌려줄 때 SLC/TLC 모드를 다시 정한다.
+ * TLC 프리 라인이 여유 있으면 SLC가 slc_max_pcent까지 커지고, 차오르면 SLC_PORTION까지 줄어든다.
+ */
+static bool slc_dyn = true;
+static unsigned int slc_max_pcent = 50;         // 전체 라인 중 SLC로 쓸 수 있는 최대 비율
+static unsigned int slc_dyn_reserve_pcent = 20; // SLC 확장 시에도 남겨둘 TLC 여유 라인 비율
+
+module_param(slc_dyn, bool, 0444);
+MODULE_PARM_DESC(slc_dyn, "Resize the SLC buffer according to the TLC space not taken by valid data");
+module_param(slc_max_pcent, uint, 0444);
+MODULE_PARM_DESC(slc_max_pcent, "Upper bound of lines used in SLC mode (percent)");
+module_param(slc_dyn_reserve_pcent, uint, 0444);
+MODULE_PARM_DESC(slc_dyn_reserve_pcent, "Spare TLC lines (percent of all lines) kept before SLC grows");
+
+/*
+ * 마이그레이션 시 Hot 데이터 유지: 최근 업데이트 횟수(온도 분류기)가 mg_hot_thres 이상인
+ * 페이지는 TLC로 내리지 않고 SLC 오픈 라인에 다시 쓴다 (0이면 끔).
+ * 희생 라인 하나에서 남길 수 있는 양은 mg_retain_max_pcent로 제한해 마이그레이션이
+ * 항상 SLC 공간을 순수하게 회수하도록 한다.
+ */
+static unsigned int mg_hot_thres = 2;
+static unsigned int mg_retain_max_pcent = 50;
+
+module_param(mg_hot_thres, uint, 0644);
+MODULE_PARM_DESC(mg_hot_thres, "Recent update count at which migration keeps a page in SLC (0: disable)");
+module_param(mg_retain_max_pcent, uint, 0644);
+MODULE_PARM_DESC(mg_retain_max_pcent, "Max percent of an SLC line that migration may keep in SLC");
+
+/*
+ * 순차 스트림 SLC 우회 (slc_buf 모드): 같은 스트림으로 연속해서 쓰인 양이
+ * seq_bypass_pages 이상이면 그 쓰기는 SLC 대신 TLC 유저 포인터로 보낸다 (0이면 끔).
+ */
+static unsigned int seq_bypass_pages = 256;
+
+module_param(seq_bypass_pages, uint, 0644);
+MODULE_PARM_DESC(seq_bypass_pages, "Sequential run length (pages) after which writes bypass the SLC buffer (0: disable)");
+
+// 증분 GC: 희생 라인을 한 번에 정리하지 않고 쓰기마다 조금씩 나눠 정리
+static bool incr_gc = false;
+module_param(incr_gc, bool, 0444);
+MODULE_PARM_DESC(incr_gc, "Reclaim victim lines in bounded steps interleaved with user writes");
+
+// 유저 쓰기 스트림(Hot/Cold 분리) 설정
+static unsigned int nr_streams = 1;         // TLC 유저 쓰기 포인터(오픈 라인) 수, 1이면 분리 안 함
+static unsigned int stream_chunk_shift = 0; // 온도 추적 단위: 2^shift 개 LPN 묶음
+static unsigned int stream_decay_pages = 0; // 유저 페이지가 이만큼 쓰이면 온도를 절반으로 감쇠 (0: 파티션 용량)
+
+module_param(nr_streams, uint, 0444);
+MODULE_PARM_DESC(nr_streams, "Number of temperature-separated user write streams (1-4)");
+module_param(stream_chunk_shift, uint, 0444);
+MODULE_PARM_DESC(stream_chunk_shift, "Track update frequency per 2^shift LPNs");
+module_param(stream_decay_pages, uint, 0444);
+MODULE_PARM_DESC(stream_decay_pages, "User pages per partition between update-count halvings (0: partition size)");
+
+// 모듈 파라미터로 받은 유저 스트림 수를 유효 범위로 보정
+static uint32_t conv_nr_streams(void)
+{
+    return clamp_t(uint32_t, nr_streams, 1, MAX_USER_STREAMS);
+}
+
+// GC 목적지 세대(Generation) 수: 재배치 횟수가 많을수록 뒤 세대의 GC 라인으로 모음
+static unsigned int nr_gc_gens = 1;
+module_param(nr_gc_gens, uint, 0444);
+MODULE_PARM_DESC(nr_gc_gens, "Number of generational GC write pointers (1-4)");
+
+static uint32_t conv_nr_gc_gens(void)
+{
+    return clamp_t(uint32_t, nr_gc_gens, 1, MAX_GC_GENS);
+}
+
+// Cost-Benefit 인덱스 결과를 기존 선형 스캔과 비교 검증 (테스트용, 느림)
+static bool cb_validate = false;
+module_param(cb_validate, bool, 0644);
+MODULE_PARM_DESC(cb_validate, "Cross-check indexed cost-benefit victims against a linear scan");
+
+// 파티션별 FTL 스레드를 띄울 CPU 목록. 비어 있으면 디스패처가 모두 처리
+static char *ftl_cpus;
+module_param(ftl_cpus, charp, 0444);
+MODULE_PARM_DESC(ftl_cpus, "CPU list for per-partition FTL threads, Separated by Comma(,)");
+
 /* ========================================================= */
 /* [Meen's Debug] Hot/Cold GC 카운터 및 기준 설정 */
 /* 150MB 지점 LPN = 38400 (FIO 스크립트 기준) */
 #define HOT_REGION_LPN_LIMIT  524288
 
-static unsigned long total_gc_cnt = 0; // 총 GC 횟수
-static unsigned long hot_gc_cnt = 0;   // Hot 블록이 잡힌 횟수
-static unsigned long cold_gc_cnt = 0;  // Cold 블록이 잡힌 횟수
-static uint64_t victim_total_age = 0;
-static uint64_t victim_chosen_cnt = 0;
+/* 파티션 스레드들이 동시에 갱신하므로 atomic */
+static atomic64_t total_gc_cnt = ATOMIC64_INIT(0); // 총 GC 횟수
+static atomic64_t hot_gc_cnt = ATOMIC64_INIT(0);   // Hot 블록이 잡힌 횟수
+static atomic64_t cold_gc_cnt = ATOMIC64_INIT(0);  // Cold 블록이 잡힌 횟수
+static atomic64_t victim_total_age = ATOMIC64_INIT(0);
+static atomic64_t victim_chosen_cnt = ATOMIC64_INIT(0);
 /* ==================================== ===================== */
 
+// 쓰기 포인터가 여는 라인의 원샷(One-shot) 프로그램 단위 페이지 수 (SLC/TLC)
+static inline uint32_t wp_pgs_per_oneshotpg(struct conv_ftl *conv_ftl, struct write_pointer *wp)
+{
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+
+    return (wp->lm == &conv_ftl->slc_lm) ? spp->slc_pgs_per_oneshotpg : spp->pgs_per_oneshotpg;
+}
+
+// 한 번의 (멀티 플레인) 프로그램으로 전송되는 크기: LUN의 모든 플레인 원샷을 묶어서 기록
+static inline uint64_t wp_program_size(struct conv_ftl *conv_ftl, struct write_pointer *wp)
+{
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+
+    return (uint64_t)spp->pgsz * wp_pgs_per_oneshotpg(conv_ftl, wp) * spp->pls_per_lun;
+}
+
 // 현재 페이지가 워드라인(Wordline)의 마지막 페이지인지 확인하는 함수
-static inline bool last_pg_in_wordline(struct conv_ftl *conv_ftl, struct ppa *ppa, uint32_t io_type)
+// (멀티 플레인: 마지막 플레인의 원샷까지 모였을 때 한 번에 프로그램)
+static inline bool last_pg_in_wordline(struct conv_ftl *conv_ftl, struct ppa *ppa,
+                                       struct write_pointer *wp)
 {
-    struct ssdparams *spp = &conv_ftl->ssd->sp; // SSD 파라미터 가져오기
     // 현재 페이지 번호가 원샷(One-shot) 프로그래밍 단위의 끝인지 계산
-    int pgs_per_oneshot;
-    if (io_type == USER_IO && conv_ftl->slc_enabled){
-        pgs_per_oneshot = spp->slc_pgs_per_oneshotpg;
-    }else{
-        pgs_per_oneshot = spp->pgs_per_oneshotpg;
-    }
-    return (ppa->g.pg % pgs_per_oneshot) == (pgs_per_oneshot - 1);
+    uint32_t pgs_per_oneshot = wp_pgs_per_oneshotpg(conv_ftl, wp);
+
+    return (ppa->g.pg % pgs_per_oneshot) == (pgs_per_oneshot - 1) &&
+           ppa->g.pl == conv_ftl->ssd->sp.pls_per_lun - 1;
 }
 // 마이그레이션이 필요한지 확인하는 함수 (기본 임계값)
 static bool should_mg(struct conv_ftl *conv_ftl)
@@ -69,9 +196,42 @@ static inline bool should_gc_high(struct conv_ftl *conv_ftl)
     return conv_ftl->tlc_lm.free_line_cnt <= conv_ftl->cp.gc_thres_lines_high;
 }
 
+// 32비트 엔트리 -> struct ppa (레지스터에서 쓰는 풀어진 형식)
+static inline struct ppa decode_ppa32(const struct ppa_codec *c, uint32_t v)
+{
+    struct ppa ppa;
+
+    if (v == PPA32_UNMAPPED) {
+        ppa.ppa = UNMAPPED_PPA;
+        return ppa;
+    }
+
+    ppa.ppa = 0;
+    ppa.g.pg = v & ((1U << c->pg_bits) - 1);
+    ppa.g.blk = (v >> c->blk_shift) & ((1U << c->blk_bits) - 1);
+    ppa.g.pl = (v >> c->pl_shift) & ((1U << c->pl_bits) - 1);
+    ppa.g.lun = (v >> c->lun_shift) & ((1U << c->lun_bits) - 1);
+    ppa.g.ch = v >> c->ch_shift;
+    return ppa;
+}
+
+// struct ppa -> 32비트 엔트리
+static inline uint32_t encode_ppa32(const struct ppa_codec *c, struct ppa *ppa)
+{
+    if (ppa->ppa == UNMAPPED_PPA)
+        return PPA32_UNMAPPED;
+
+    return (uint32_t)ppa->g.pg | ((uint32_t)ppa->g.blk << c->blk_shift) |
+           ((uint32_t)ppa->g.pl << c->pl_shift) | ((uint32_t)ppa->g.lun << c->lun_shift) |
+           ((uint32_t)ppa->g.ch << c->ch_shift);
+}
+
 // 매핑 테이블에서 LPN(논리 페이지 번호)에 해당하는 PPA(물리 주소)를 가져오는 함수
 static inline struct ppa get_maptbl_ent(struct conv_ftl *conv_ftl, uint64_t lpn)
 {
+    if (conv_ftl->compact_map)
+        return decode_ppa32(&conv_ftl->codec, conv_ftl->maptbl32[lpn]);
+
     return conv_ftl->maptbl[lpn]; // 배열에서 해당 LPN의 PPA 반환
 }
 
@@ -79,7 +239,10 @@ static inline struct ppa get_maptbl_ent(struct conv_ftl *conv_ftl, uint64_t lpn)
 static inline void set_maptbl_ent(struct conv_ftl *conv_ftl, uint64_t lpn, struct ppa *ppa)
 {
     NVMEV_ASSERT(lpn < conv_ftl->ssd->sp.tt_pgs); // LPN이 유효 범위 내인지 확인
-    conv_ftl->maptbl[lpn] = *ppa; // 매핑 테이블 업데이트
+    if (conv_ftl->compact_map)
+        conv_ftl->maptbl32[lpn] = encode_ppa32(&conv_ftl->codec, ppa);
+    else
+        conv_ftl->maptbl[lpn] = *ppa; // 매핑 테이블 업데이트
 }
 
 // PPA(구조체 주소)를 선형적인 페이지 인덱스(정수)로 변환하는 함수
@@ -106,6 +269,12 @@ static inline uint64_t get_rmap_ent(struct conv_ftl *conv_ftl, struct ppa *ppa)
 {
     uint64_t pgidx = ppa2pgidx(conv_ftl, ppa); // PPA를 인덱스로 변환
 
+    if (conv_ftl->compact_map) {
+        uint32_t lpn = conv_ftl->rmap32[pgidx];
+
+        return (lpn == LPN32_INVALID) ? INVALID_LPN : lpn;
+    }
+
     return conv_ftl->rmap[pgidx]; // 해당 물리 위치의 LPN 반환
 }
 
@@ -115,7 +284,114 @@ static inline void set_rmap_ent(struct conv_ftl *conv_ftl, uint64_t lpn, struct
 {
     uint64_t pgidx = ppa2pgidx(conv_ftl, ppa); // PPA를 인덱스로 변환
 
-    conv_ftl->rmap[pgidx] = lpn; // 역매핑 테이블 업데이트
+    if (conv_ftl->compact_map)
+        conv_ftl->rmap32[pgidx] = (lpn == INVALID_LPN) ? LPN32_INVALID : (uint32_t)lpn;
+    else
+        conv_ftl->rmap[pgidx] = lpn; // 역매핑 테이블 업데이트
+}
+
+/*
+ * [온도 분류기]
+ * LPN(또는 2^stream_chunk_shift개 LPN 묶음)별로 업데이트 횟수를 세고,
+ * 일정량의 유저 쓰기(epoch)마다 카운터를 절반으로 줄여 최근 빈도만 반영한다.
+ * 감쇠는 해당 엔트리에 접근할 때 밀린 epoch 수만큼 한꺼번에 적용 (전체 순회 없음).
+ * 스트림 번호 = log2(카운터), 즉 0번이 가장 Cold, 번호가 클수록 Hot.
+ * 스트림이 하나뿐이고 마이그레이션 Hot 유지도 쓰지 않으면 테이블을 만들지 않는다 (heat == NULL).
+ */
+static inline struct lpn_heat *get_heat_ent(struct conv_ftl *conv_ftl, uint64_t idx)
+{
+    struct lpn_heat *h = &conv_ftl->heat[idx];
+    uint16_t missed = conv_ftl->heat_epoch - h->epoch;
+
+    if (missed) {
+        h->cnt = (missed >= 8) ? 0 : (h->cnt >> missed);
+        h->epoch = conv_ftl->heat_epoch;
+    }
+    return h;
+}
+
+static inline struct lpn_heat *get_lpn_heat(struct conv_ftl *conv_ftl, uint64_t lpn)
+{
+    return get_heat_ent(conv_ftl, lpn >> stream_chunk_shift);
+}
+
+/*
+ * epoch를 넘기면서 테이블 일부에 감쇠를 미리 반영한다. HEAT_SWEEP_EPOCHS마다 테이블 전체를
+ * 한 바퀴 돌므로 어떤 엔트리도 16비트 epoch 차이가 wrap될 만큼 오래 방치되지 않는다.
+ */
+static void advance_heat_epoch(struct conv_ftl *conv_ftl)
+{
+    uint64_t i;
+
+    conv_ftl->heat_epoch++;
+    for (i = 0; i < conv_ftl->heat_sweep_step; i++) {
+        get_heat_ent(conv_ftl, conv_ftl->heat_sweep_pos);
+        if (++conv_ftl->heat_sweep_pos == conv_ftl->nr_heat_ents)
+            conv_ftl->heat_sweep_pos = 0;
+    }
+}
+
+static inline uint32_t heat_to_stream(struct conv_ftl *conv_ftl, uint8_t cnt)
+{
+    if (cnt == 0)
+        return 0;
+    return min_t(uint32_t, fls(cnt) - 1, conv_ftl->nr_streams - 1);
+}
+
+// 유저 쓰기 시 호출: 업데이트 빈도를 갱신하고 이 쓰기가 들어갈 스트림을 반환
+static uint32_t classify_user_write(struct conv_ftl *conv_ftl, uint64_t lpn)
+{
+    struct lpn_heat *h;
+
+    if (!conv_ftl->heat)
+        return 0;
+
+    h = get_lpn_heat(conv_ftl, lpn);
+    if (h->cnt < U8_MAX)
+        h->cnt++;
+
+    if (++conv_ftl->heat_pgs_written >= conv_ftl->heat_decay_pgs) {
+        conv_ftl->heat_pgs_written = 0;
+        advance_heat_epoch(conv_ftl);
+    }
+    return heat_to_stream(conv_ftl, h->cnt);
+}
+
+// 빈도 갱신 없이 LPN의 현재 스트림만 조회 (GC 통계용)
+static uint32_t get_lpn_stream(struct conv_ftl *conv_ftl, uint64_t lpn)
+{
+    if (!conv_ftl->heat)
+        return 0;
+    return heat_to_stream(conv_ftl, get_lpn_heat(conv_ftl, lpn)->cnt);
+}
+
+static void init_lpn_heat(struct conv_ftl *conv_ftl)
+{
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+
+    conv_ftl->heat = NULL;
+    conv_ftl->heat_epoch = 0;
+    conv_ftl->heat_pgs_written = 0;
+    conv_ftl->heat_decay_pgs = stream_decay_pages ? stream_decay_pages : spp->tt_pgs;
+    conv_ftl->nr_heat_ents = (spp->tt_pgs >> stream_chunk_shift) + 1;
+    conv_ftl->heat_sweep_pos = 0;
+    conv_ftl->heat_sweep_step = DIV_ROUND_UP(conv_ftl->nr_heat_ents, HEAT_SWEEP_EPOCHS);
+
+    /*
+     * 스트림이 하나이고 SLC 버퍼도 없으면 테이블이 필요 없다.
+     * mg_hot_thres는 실행 중에 바꿀 수 있으므로 SLC 버퍼 모드에서는 항상 만든다.
+     */
+    if (conv_ftl->nr_streams == 1 && !conv_ftl->slc_enabled)
+        return;
+
+    conv_ftl->heat = vzalloc(sizeof(struct lpn_heat) * conv_ftl->nr_heat_ents);
+    if (!conv_ftl->heat)
+        NVMEV_ERROR("Failed to allocate update-frequency table, streams disabled\n");
+}
+
+static void remove_lpn_heat(struct conv_ftl *conv_ftl)
+{
+    vfree(conv_ftl->heat);
 }
 /*전략별 pqueue사용 및 우선순위 조회 함수*/
 // Greedy용 우선순위 조회: VPC(유효 페이지)가 점수
@@ -146,28 +422,55 @@ static inline void victim_line_set_pos(void *a, size_t pos)
 {
 	((struct line *)a)->pos = pos;
 }
-// 쓰기 크레딧(Write Credit)을 하나 소모하는 함수
-static inline void consume_write_credit(struct conv_ftl *conv_ftl)
+// 쓰기 크레딧(Write Credit)을 하나 소모하는 함수 (쓰기 포인터가 속한 라인 관리자의 크레딧)
+static inline void consume_write_credit(struct conv_ftl *conv_ftl, struct write_pointer *wp)
 {
-    if(conv_ftl->slc_enabled){
+    if (wp->lm == &conv_ftl->slc_lm) {
         conv_ftl->slc_wfc.write_credits--; // 크레딧 감소 (쓰기 허용량 차감)
-    } else{
+    } else {
         conv_ftl->tlc_wfc.write_credits--;
     }
-    
 }
 
-// 전경(Foreground) GC 함수 선언
+// 전경(Foreground) GC/마이그레이션 함수 선언
 static void foreground_gc(struct conv_ftl *conv_ftl);
-// 전경(Foreground) GC 함수 선언
-static void foreground_gc(struct conv_ftl *conv_ftl);
-// 쓰기 크레딧을 확인하고 부족하면 GC를 수행해 채우는 함수
+static void foreground_mg(struct conv_ftl *conv_ftl);
+static int conv_part_worker(void *data);
+static bool conv_proc_pending(struct nvmev_ns *ns, unsigned int id);
+
+// 파티션 스레드에 넘긴 작업이 (모든 디스패처의 큐에서) 다 실행되었는지
+static inline bool conv_part_idle(struct conv_ftl *conv_ftl)
+{
+    uint32_t i;
+
+    if (!conv_ftl->part_worker)
+        return true;
 
+    for (i = 0; i < conv_ftl->nr_jqs; i++) {
+        if (READ_ONCE(conv_ftl->jqs[i].done) != READ_ONCE(conv_ftl->jqs[i].tail))
+            return false;
+    }
+    return true;
+}
+static void incr_reclaim(struct conv_ftl *conv_ftl, struct write_flow_control *wfc, bool mg);
 
-static inline void check_and_refill_write_credit(struct conv_ftl *conv_ftl)
+// 쓰기 크레딧을 확인하고 부족하면 GC를 수행해 채우는 함수
+
+static inline void check_and_refill_write_credit(struct conv_ftl *conv_ftl,
+                                                 struct write_pointer *wp)
 {
     struct write_flow_control *wfc;
-    if(conv_ftl->slc_enabled){
+    bool slc = (wp->lm == &conv_ftl->slc_lm);
+
+    if (incr_gc) {
+        if (slc)
+            incr_reclaim(conv_ftl, &conv_ftl->slc_wfc, true);
+        else
+            incr_reclaim(conv_ftl, &conv_ftl->tlc_wfc, false);
+        return;
+    }
+
+    if (slc) {
         wfc = &(conv_ftl->slc_wfc);
         if(wfc->write_credits <= 0){
             foreground_mg(conv_ftl);
@@ -185,26 +488,74 @@ static inline void check_and_refill_write_credit(struct conv_ftl *conv_ftl)
     
 }
 
+// 라인 관리자(SLC/TLC)에 따른 라인당 페이지 수
+static inline uint32_t lm_pgs_per_line(struct conv_ftl *conv_ftl, struct line_mgmt *lm)
+{
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+
+    return (lm == &conv_ftl->slc_lm) ? spp->slc_pgs_per_line : spp->pgs_per_line;
+}
+
+/*
+ * TLC 여유 라인 수: TLC 라인 중 유효 데이터가 차지하지 않는 만큼.
+ * 프리 TLC 라인 수는 GC가 임계값 근처로만 유지하므로 트림 등으로 공간이 생겨도 늘지 않는다.
+ * 대신 유효 페이지 기준으로 보면 GC가 (대부분 빈 라인에서) 되찾을 수 있는 공간까지 센다.
+ */
+static inline uint32_t tlc_slack_lines(struct conv_ftl *conv_ftl)
+{
+    uint32_t used = DIV_ROUND_UP(conv_ftl->tlc_vpc, conv_ftl->ssd->sp.pgs_per_line);
+
+    return conv_ftl->tlc_lm.tt_lines > used ? conv_ftl->tlc_lm.tt_lines - used : 0;
+}
+
+/*
+ * 지워진 라인을 다음에 어떤 모드로 쓸지 결정
+ * - SLC는 [slc_min_lines, slc_line_limit] 범위 안에서만 변한다
+ * - TLC 여유 라인이 slc_dyn_reserve보다 많을 때만 SLC를 유지/확장하고, 아니면 TLC로 돌려준다
+ * - TLC 라인을 SLC로 돌릴 때는 긴급 GC 임계값 위로 프리 TLC 라인을 남긴다
+ */
+static bool want_slc_line(struct conv_ftl *conv_ftl, bool was_slc)
+{
+    uint32_t slc_lines = conv_ftl->slc_lm.tt_lines;
+    uint32_t slack = tlc_slack_lines(conv_ftl);
+
+    if (!conv_ftl->slc_enabled)
+        return false;
+    if (was_slc)
+        return slc_lines <= conv_ftl->slc_min_lines || slack > conv_ftl->slc_dyn_reserve;
+    return slc_lines < conv_ftl->slc_line_limit && slack > conv_ftl->slc_dyn_reserve &&
+           conv_ftl->tlc_lm.free_line_cnt > conv_ftl->cp.gc_thres_lines_high;
+}
+
+// 유휴 마이그레이션 워터마크: 프리 SLC 라인이 이 값 이하이면 백그라운드로 비운다
+// (오픈 라인 하나는 항상 사용 중이므로 tt_lines - 1이 상한)
+static void update_mg_watermark(struct conv_ftl *conv_ftl)
+{
+    uint32_t tt = conv_ftl->slc_lm.tt_lines;
+    uint32_t target = min_t(uint32_t, tt - 1, tt * min_t(uint32_t, bg_mg_free_pcent, 100) / 100);
+
+    conv_ftl->cp.mg_thres_lines = max_t(uint32_t, conv_ftl->cp.mg_thres_lines_high,
+            target ? target - 1 : 0);
+}
+
 // ---------------------------------------------------------
 // 전략 1: Greedy (기존 방식) - PQ의 Root(1등) 사용
 // ---------------------------------------------------------
-static struct line *select_victim_greedy(struct conv_ftl *conv_ftl, bool force)
+static struct line *select_victim_greedy(struct conv_ftl *conv_ftl, struct line_mgmt *lm, bool force)
 {
-
-    struct ssdparams *spp = &conv_ftl->ssd->sp;
-    struct line_mgmt *lm = &conv_ftl->tlc_lm;
     struct line *victim_line = pqueue_peek(lm->victim_line_pq); // 1등 확인
 
     if (!victim_line) return NULL;
     
     // Greedy 특유의 효율성 체크 (VPC가 너무 많으면 GC 안 함)
-    if (!force && (victim_line->vpc > (conv_ftl->ssd->sp.pgs_per_line / 8))) {
+    if (!force && (victim_line->vpc > (lm_pgs_per_line(conv_ftl, lm) / 8))) {
         return NULL;
     }
-    victim_total_age += (ktime_get_ns()-(victim_line->last_modified_time))/1000000;
-    victim_chosen_cnt++;
+    atomic64_add((ktime_get_ns() - victim_line->last_modified_time) / 1000000, &victim_total_age);
+    atomic64_inc(&victim_chosen_cnt);
     pqueue_pop(lm->victim_line_pq); // 1등 꺼내기
     victim_line->pos = 0;
+    victim_line->victim = false;
     lm->victim_line_cnt--;
     return victim_line;
 }
@@ -212,23 +563,22 @@ static struct line *select_victim_greedy(struct conv_ftl *conv_ftl, bool force)
 // ---------------------------------------------------------
 // 전략 2: Random - 배열 인덱스로 콕 찍기 (O(1))
 // ---------------------------------------------------------
-static struct line *select_victim_random(struct conv_ftl *conv_ftl, bool force)
+static struct line *select_victim_random(struct conv_ftl *conv_ftl, struct line_mgmt *lm, bool force)
 {
-
-    struct ssdparams *spp = &conv_ftl->ssd->sp;
-    struct line_mgmt *lm = &conv_ftl->tlc_lm;
     pqueue_t *q = lm->victim_line_pq;   //pqueue를 그대로 가져옴 원본을
+    size_t nr = pqueue_size(q); // d[0]은 더미이므로 실제 원소는 d[1..nr]
     
-    if (q->size == 0) return NULL; // 비어있으면 종료
+    if (nr == 0) return NULL; // 비어있으면 종료
 
     // 난수 생성하여 인덱스 바로 접근 (Linear Scan 아님!) 시간복잡도 O(1)으로 예상
-    size_t rand_idx = (get_random_u32() % q->size) + 1;
+    size_t rand_idx = (get_random_u32() % nr) + 1;
     struct line *victim_line = (struct line *)q->d[rand_idx];
 
     // 선택된 녀석을 큐에서 강제로 제거 (중간 빼기)
     pqueue_remove(q, victim_line);
     
     victim_line->pos = 0;
+    victim_line->victim = false;
     lm->victim_line_cnt--;
     return victim_line;
 }
@@ -248,118 +598,294 @@ static struct line *select_victim_random(struct conv_ftl *conv_ftl, bool force)
 #define THRESHOLD_HOT       SEC_TO_NS(5)
 #define THRESHOLD_WARM      SEC_TO_NS(60)
 
+// 나이 구간(Tier)별 상한값과 가중치. 마지막 구간(Cold)은 상한 없음
+static const uint64_t cb_tier_limit[CB_AGE_TIERS - 1] = {
+    THRESHOLD_VERY_HOT, THRESHOLD_HOT, THRESHOLD_WARM,
+};
+static const uint64_t cb_tier_weight[CB_AGE_TIERS] = {
+    1,   // [Level 0] Very Hot: 곧 다시 쓰일 확률 매우 높음, 절대 건드리지 않도록 최소 가중치
+    5,   // [Level 1] Hot: 아직 활성 상태로 간주
+    20,  // [Level 2] Warm: '식어가는' 데이터, 당장 급하지 않다면 놔두는 게 좋음
+    100, // [Level 3] Cold: 사실상 정적 데이터, IPC가 조금만 있어도 즉시 청소하는 게 이득
+};
+
+// 나이(ns)가 속한 구간(Tier) 번호 반환
+static int get_age_tier(uint64_t age_ns)
+{
+    int t;
+
+    for (t = 0; t < CB_AGE_TIERS - 1; t++) {
+        if (age_ns < cb_tier_limit[t])
+            return t;
+    }
+    return CB_AGE_TIERS - 1;
+}
+
 /*
  * Age Weight Function (구간별 계단 함수)
  * 반환값: 가중치 (클수록 GC 대상이 될 확률 높음)
  */
 static uint64_t get_age_weight(uint64_t age_ns)
 {
-    // [Level 0] Very Hot (0 ~ 100ms)
-    // 방금 기록됨. 참조 국지성(Locality)에 의해 곧 다시 쓰일 확률 매우 높음.
-    // 절대 건드리지 않도록 최소 가중치 부여.
-    if (age_ns < THRESHOLD_VERY_HOT) {
-        return 1; 
+    return cb_tier_weight[get_age_tier(age_ns)];
+}
+
+static inline uint64_t line_age(struct line *line, uint64_t now)
+{
+    return (now > line->last_modified_time) ? (now - line->last_modified_time) : 0;
+}
+
+// Cost-Benefit 점수: Benefit(Age 가중치 * IPC) / Cost(VPC + 1)
+static inline uint64_t cb_score(struct line *line, uint64_t weight)
+{
+    return weight * line->ipc / (line->vpc + 1);
+}
+
+/*
+ * [Cost-Benefit 인덱스]
+ * 같은 Tier 안에서는 가중치가 같고, 희생 후보 라인은 모두 꽉 채워진 라인이므로
+ * ipc + vpc = 라인당 페이지 수(상수)이다. 따라서 Tier 내부의 CB 점수는 vpc에 대해
+ * 단조 감소하고, Tier별 VPC Min-Heap의 Root가 그 Tier의 최고 점수 라인이 된다.
+ * 시간이 흐르면서 라인이 더 오래된 Tier로 넘어가야 하므로, Tier마다 last_modified_time
+ * 순으로 정렬된 리스트를 함께 유지하고 선택 시점에 리스트 앞쪽부터 Tier를 옮겨준다.
+ * -> 선택은 O(Tier 수 * log N), 라인당 Tier 이동은 최대 (Tier 수 - 1)번
+ *
+ * 쓰기 경로의 재삽입(페이지 무효화)은 last_modified_time이 방금 시각이므로 항상 꼬리에 붙인다.
+ * 시간 순서가 어긋날 수 있는 삽입은 두 가지뿐이다.
+ *  - 오래전에 무효화된 페이지를 가진 라인이 다 채워져 후보가 될 때 (라인을 채울 때 한 번)
+ *  - cb_tier_age()가 라인을 다음 Tier로 옮길 때 (라인당 최대 Tier 수 - 1번)
+ * 이때만 꼬리에서부터 자리를 찾으며, 건너뛰는 라인은 그 Tier에서 더 최근에 수정된 라인들이다.
+ * 따라서 이동 비용은 라인 한 개의 수명 동안 Tier 수 * (Tier 크기)로 묶인다.
+ */
+
+// 페이지 무효화로 다시 들어가는 라인: 가장 최근 시각이므로 꼬리에 바로 붙임 (O(1))
+static void cb_tier_requeue(struct line_mgmt *lm, struct line *line, uint64_t now)
+{
+    line->tier = get_age_tier(line_age(line, now));
+    pqueue_insert(lm->cb_tier_pq[line->tier], line);
+    list_add_tail(&line->tier_entry, &lm->cb_tier_list[line->tier]);
+}
+
+// 시간 순서가 어긋날 수 있는 삽입: 꼬리에서부터 last_modified_time 자리를 찾는다 (위 설명 참고)
+static void cb_tier_insert(struct line_mgmt *lm, struct line *line, uint64_t now)
+{
+    struct list_head *head, *pos;
+
+    line->tier = get_age_tier(line_age(line, now));
+    pqueue_insert(lm->cb_tier_pq[line->tier], line);
+
+    head = &lm->cb_tier_list[line->tier];
+    list_for_each_prev(pos, head) {
+        struct line *cur = list_entry(pos, struct line, tier_entry);
+
+        if (cur->last_modified_time <= line->last_modified_time)
+            break;
     }
-    
-    // [Level 1] Hot (100ms ~ 5s)
-    // 1초 내외의 데이터. 아직 활성 상태로 간주.
-    else if (age_ns < THRESHOLD_HOT) {
-        return 5;
+    list_add(&line->tier_entry, pos);
+}
+
+static void cb_tier_remove(struct line_mgmt *lm, struct line *line)
+{
+    pqueue_remove(lm->cb_tier_pq[line->tier], line);
+    list_del_init(&line->tier_entry);
+    line->pos = 0;
+}
+
+// 나이가 들어 구간 상한을 넘긴 라인들을 다음 Tier로 이동
+static void cb_tier_age(struct line_mgmt *lm, uint64_t now)
+{
+    int t;
+
+    for (t = 0; t < CB_AGE_TIERS - 1; t++) {
+        struct list_head *head = &lm->cb_tier_list[t];
+
+        while (!list_empty(head)) {
+            struct line *line = list_first_entry(head, struct line, tier_entry);
+
+            if (line_age(line, now) < cb_tier_limit[t])
+                break; // 리스트가 시간순이므로 나머지는 모두 아직 이 Tier
+            cb_tier_remove(lm, line);
+            cb_tier_insert(lm, line, now);
+        }
     }
-    
-    // [Level 2] Warm (5s ~ 60s)
-    // 12초, 22초 등 로그에서 보인 '식어가는' 데이터들.
-    // 당장 급하지 않다면 놔두는 게 좋음.
-    else if (age_ns < THRESHOLD_WARM) {
-        return 20;
+}
+
+// 희생 후보 인덱스(PQ 또는 CB Tier Heap)에 라인 추가
+static void victim_line_insert(struct line_mgmt *lm, struct line *line)
+{
+    if (gc_mode == GC_MODE_COST_BENEFIT)
+        cb_tier_insert(lm, line, ktime_get_ns());
+    else
+        pqueue_insert(lm->victim_line_pq, line);
+    line->victim = true;
+    lm->victim_line_cnt++;
+}
+
+// 희생 후보 라인의 페이지가 하나 무효화됨: vpc 감소 및 인덱스 위치 갱신
+static void victim_line_invalidate_one(struct line_mgmt *lm, struct line *line)
+{
+    if (gc_mode == GC_MODE_COST_BENEFIT) {
+        // last_modified_time이 방금 갱신되었으므로 Very Hot Tier의 꼬리로 다시 들어감
+        cb_tier_remove(lm, line);
+        line->vpc--;
+        cb_tier_requeue(lm, line, ktime_get_ns());
+    } else {
+        /* Note that line->vpc will be updated by this call */
+        pqueue_change_priority(lm->victim_line_pq, line->vpc - 1, line);
     }
-    
-    // [Level 3] Cold / Frozen (60s ~ )
-    // 로그에서 120초~169초 데이터가 대거 발견됨.
-    // 이들은 사실상 '정적 데이터(Static Data)'이므로
-    // 무효 페이지(IPC)만 조금 있어도 즉시 청소하는 게 이득.
-    else {
-        return 100; // 가중치 최대 (GC 1순위)
+}
+
+/*
+ * 검증용 선형 스캔 (O(N)): 인덱스가 아니라 라인 배열 전체에서 희생 후보 상태인 라인을 모아
+ * vpc와 last_modified_time으로 점수를 다시 계산한다.
+ * 점수가 같으면 인덱스와 같은 규칙으로 더 오래된(Cold) Tier를, Tier도 같으면 vpc가 작은 라인을 고른다.
+ * 인덱스에서 빠졌거나 Tier가 틀린 라인도 여기서 찾아 *nr_bad에 센다.
+ */
+static struct line *cb_scan_best(struct conv_ftl *conv_ftl, struct line_mgmt *lm, uint64_t now,
+                                 uint64_t *best_score, int *best_tier, uint32_t *nr_bad)
+{
+    uint32_t pgs_per_line = lm_pgs_per_line(conv_ftl, lm);
+    struct line *best_victim = NULL;
+    uint64_t max_score = 0;
+    int max_tier = -1;
+    uint32_t i;
+
+    *nr_bad = 0;
+    for (i = 0; i < conv_ftl->ssd->sp.tt_lines; i++) {
+        struct line *cand = &lm->lines[i];
+        int tier;
+        uint64_t score;
+
+        if (!cand->victim || cand->slc != (lm == &conv_ftl->slc_lm))
+            continue;
+
+        tier = get_age_tier(line_age(cand, now));
+        score = cb_tier_weight[tier] * (pgs_per_line - cand->vpc) / (cand->vpc + 1);
+
+        if (!cand->pos || cand->tier != tier) {
+            (*nr_bad)++;
+            NVMEV_ERROR("CB index: line %d %s (tier %d, expected %d)\n", cand->id,
+                    cand->pos ? "in wrong tier" : "missing from index", cand->tier, tier);
+        }
+
+        if (!score)
+            continue; // 인덱스도 점수 0인 라인은 고르지 않음
+        if (score > max_score ||
+            (score == max_score && (tier > max_tier ||
+                                    (tier == max_tier && cand->vpc < best_victim->vpc)))) {
+            max_score = score;
+            max_tier = tier;
+            best_victim = cand;
+        }
     }
+
+    *best_score = max_score;
+    *best_tier = max_tier;
+    return best_victim;
 }
+
 // ---------------------------------------------------------
-// 전략 3: Cost-Benefit - 전체 스캔 (Linear Scan, O(N))
+// 전략 3: Cost-Benefit - Tier별 Heap 인덱스 (O(log N))
 // ---------------------------------------------------------
 // Cost-Benefit 정책을 사용하여 희생 라인(Victim Line)을 선택하는 함수
-// (Heap의 정렬을 무시하고 전체를 뒤져서 최적의 대상을 찾음)
-static struct line *select_victim_cb(struct conv_ftl *conv_ftl, bool force)
+// - 각 Tier Heap의 Root만 비교하면 전체 스캔과 같은 최고 점수를 얻음
+// - cb_validate가 켜져 있으면 라인 배열 전체 스캔 결과와 고른 라인을 비교 검증
+//   (점수와 Tier, vpc가 모두 같은 라인끼리는 정책상 구별되지 않으므로 같은 선택으로 본다)
+static struct line *select_victim_cb(struct conv_ftl *conv_ftl, struct line_mgmt *lm, bool force)
 {
-
-    struct ssdparams *spp = &conv_ftl->ssd->sp;
-    // 1. 편의를 위해 긴 구조체 경로를 짧은 변수명(lm)으로 할당
-    struct line_mgmt *lm = &conv_ftl->tlc_lm;
-    // 2. 우선순위 큐 구조체 포인터 가져오기
-    pqueue_t *q = lm->victim_line_pq;
-    // 3. 현재까지 찾은 '최고의 희생양'을 저장할 포인터 초기화
     struct line *best_victim = NULL;
-    
-    // 4. 현재까지 발견된 '최고 점수'를 저장할 변수 (초기값 0 또는 -1)
-    uint64_t max_score = 0; 
-    uint64_t victim_age = 0;
-    // 5. 나이(Age) 계산을 위해 현재 커널 시간(나노초 단위)을 가져옴
+    uint64_t max_score = 0;
     uint64_t now = ktime_get_ns();
-    
-    // 6. 반복문 제어를 위한 인덱스 변수
-    size_t i;
-
-    // 7. 큐(Victim List)가 비어있다면, 청소할 블록이 없으므로 NULL 반환
-    if (q->size == 0) return NULL;
-
-    // ★ 8. 큐 내부 배열(d)을 처음부터 끝까지 순회 (Linear Scan, O(N))
-    // - 이유: '시간(Age)'은 모든 블록에 대해 동시에 흐르므로, 
-    //   특정 시점에 고정된 우선순위 큐(Heap)로는 최신 점수를 반영할 수 없음.
-    // - i = 1부터 시작하는 이유: pqueue 라이브러리는 0번 인덱스를 더미(비움)로 쓰고 1번부터 저장함
-    for (i = 1; i <= q->size; i++) {
-        // 9. 현재 인덱스(i)에 있는 라인(블록) 포인터를 가져옴 (void* -> struct line*)
-        struct line *cand = (struct line *)q->d[i];
-        if (!cand) {
-            // NULL이면 이 항목은 건너뛰고 계속 진행
+    int t;
+
+    cb_tier_age(lm, now);
+
+    // 점수가 같으면 더 오래된(Cold) Tier를 우선
+    for (t = CB_AGE_TIERS - 1; t >= 0; t--) {
+        struct line *cand = pqueue_peek(lm->cb_tier_pq[t]);
+        uint64_t score;
+
+        if (!cand)
             continue;
-        }
-        // 10. Age(나이) 계산: (현재 시간 - 마지막으로 데이터가 쓰인 시간)
-        // - 삼항 연산자: 혹시라도 시간이 역전되는 오류를 방지하기 위해 0 처리
-        uint64_t age = (now > cand->last_modified_time) ? 
-                       (now - cand->last_modified_time) : 0;
-      
-        
-        uint64_t age_weight = get_age_weight(age);
-        // 11. Cost-Benefit 점수 계산
-        // - 공식: Benefit(Age * IPC) / Cost(2 * VPC)
-        // - (cand->vpc + 1): 분모가 0이 되어 프로그램이 죽는 것을 방지
-        uint64_t numerator= age_weight * cand->ipc;
-        uint64_t score =  numerator / (cand->vpc + 1);
-        // 12. 현재 블록의 점수가 지금까지 찾은 최대 점수보다 높은지 확인
+
+        score = cb_score(cand, cb_tier_weight[t]);
         if (score > max_score) {
-            // 13. 최고 점수 갱신
             max_score = score;
-            victim_age = age;
-            // 14. 현재 블록을 '최고의 희생양' 후보로 등록
             best_victim = cand;
         }
     }
 
-    // 15. 전체를 다 뒤져서 희생양(best_victim)을 찾았다면
+    if (cb_validate) {
+        uint64_t scan_score;
+        int scan_tier;
+        uint32_t nr_bad;
+        struct line *scan_victim = cb_scan_best(conv_ftl, lm, now, &scan_score, &scan_tier, &nr_bad);
+        bool same = (scan_victim == best_victim) ||
+                    (scan_victim && best_victim && scan_score == max_score &&
+                     scan_tier == best_victim->tier && scan_victim->vpc == best_victim->vpc);
+
+        conv_ftl->cb_validate_cnt++;
+        if (!same || nr_bad) {
+            conv_ftl->cb_validate_mismatch++;
+            NVMEV_ERROR("CB index mismatch: index line %d (score %llu) vs scan line %d (score %llu), %u bad lines\n",
+                    best_victim ? best_victim->id : -1, max_score,
+                    scan_victim ? scan_victim->id : -1, scan_score, nr_bad);
+        }
+    }
+
     if (best_victim) {
-        // 16. 우선순위 큐에서 해당 라인을 '안전하게' 제거
-        // (pqueue_pop은 맨 위만 빼지만, remove는 중간에 있는 놈을 빼고 트리를 재정렬함)
-        victim_total_age += victim_age / 1000000;
-        victim_chosen_cnt++;
-        pqueue_remove(q, best_victim); 
-        // 17. 해당 라인의 큐 위치 정보 초기화 (큐에서 빠졌음을 표시)
-        best_victim->pos = 0;
-        
-        // 18. 전체 희생 후보 라인 개수 감소
+        atomic64_add(line_age(best_victim, now) / 1000000, &victim_total_age);
+        atomic64_inc(&victim_chosen_cnt);
+        cb_tier_remove(lm, best_victim);
+        best_victim->victim = false;
         lm->victim_line_cnt--;
     }
 
-    // 19. 최종 선택된 희생 라인 반환 (이후 do_gc 함수가 이 블록을 청소함)
+    // 최종 선택된 희생 라인 반환 (이후 do_gc 함수가 이 블록을 청소함)
     return best_victim;
 }
+
+// 희생 후보 인덱스 생성 (CB는 Tier별 Heap, 나머지는 단일 PQ)
+static void init_victim_index(struct line_mgmt *lm, pqueue_cmp_pri_f cmp_func,
+                              pqueue_get_pri_f get_func)
+{
+    int t;
+
+    if (gc_mode != GC_MODE_COST_BENEFIT) {
+        lm->victim_line_pq = pqueue_init(lm->tt_lines, cmp_func, get_func,
+                                         victim_line_set_pri, victim_line_get_pos,
+                                         victim_line_set_pos);
+        return;
+    }
+
+    lm->victim_line_pq = NULL;
+    for (t = 0; t < CB_AGE_TIERS; t++) {
+        lm->cb_tier_pq[t] = pqueue_init(lm->tt_lines, cmp_pri_greedy, get_pri_greedy,
+                                        victim_line_set_pri, victim_line_get_pos,
+                                        victim_line_set_pos);
+        INIT_LIST_HEAD(&lm->cb_tier_list[t]);
+    }
+}
+
+static void remove_victim_index(struct line_mgmt *lm)
+{
+    int t;
+
+    if (gc_mode != GC_MODE_COST_BENEFIT) {
+        pqueue_free(lm->victim_line_pq);
+        return;
+    }
+
+    for (t = 0; t < CB_AGE_TIERS; t++)
+        pqueue_free(lm->cb_tier_pq[t]);
+}
+// 라인의 모드를 NAND 블록에 반영 (ssd_advance_nand가 모드별 지연 시간을 적용)
+static inline void set_line_cell_mode(struct conv_ftl *conv_ftl, struct line *line)
+{
+    ssd_set_blk_cell_mode(conv_ftl->ssd, line->id,
+                          line->slc ? CELL_MODE_SLC : conv_ftl->ssd->sp.cell_mode);
+}
+
 // 라인(블록 관리 단위) 초기화 함수
 static void init_lines(struct conv_ftl *conv_ftl)
 {
@@ -383,10 +909,11 @@ static void init_lines(struct conv_ftl *conv_ftl)
         break;
 
     case GC_MODE_COST_BENEFIT:
-        NVMEV_INFO("GC Strategy: COST-BENEFIT (Linear Scan)\n");
+        NVMEV_INFO("GC Strategy: COST-BENEFIT (Age-tier Heaps%s)\n",
+                   cb_validate ? ", validated by Linear Scan" : "");
         tlc_lm->select_victim = select_victim_cb; // 함수 연결
-        cmp_func = cmp_pri_dummy; // CB도 스캔할 거면 PQ 정렬은 의미 없음
-        get_func = get_pri_dummy;   
+        cmp_func = cmp_pri_greedy; // Tier별 Heap은 VPC 기준 Min-Heap (init_victim_index 참고)
+        get_func = get_pri_greedy;
         break;
 
     case GC_MODE_GREEDY:
@@ -398,96 +925,57 @@ static void init_lines(struct conv_ftl *conv_ftl)
         break;
     }
 
-    if(conv_ftl->slc_enabled){
-        slc_lm->tt_lines = spp->slc_tt_lines;
-        tlc_lm->tt_lines = spp->tlc_tt_lines;
-        NVMEV_ASSERT(slc_lm->tt_lines + tlc_lm->tt_lines == spp->tt_lines); // 라인 수 검증
-        slc_lm->lines = vmalloc(sizeof(struct line) * slc_lm->tt_lines); // 라인 구조체 배열 메모리 할당
-        tlc_lm->lines = vmalloc(sizeof(struct line) * tlc_lm->tt_lines);
+    // 라인 배열은 하나이고 각 라인의 모드(line->slc)에 따라 두 관리자 중 하나에 속한다
+    conv_ftl->lines = vmalloc(sizeof(struct line) * spp->tt_lines);
+    slc_lm->lines = tlc_lm->lines = conv_ftl->lines;
+    // 동적 SLC에서는 어느 쪽이든 모든 라인을 가질 수 있으므로 희생 인덱스를 전체 크기로 잡음
+    slc_lm->tt_lines = tlc_lm->tt_lines = spp->tt_lines;
+    if (conv_ftl->slc_enabled) {
         slc_lm->select_victim = tlc_lm->select_victim;
-        slc_lm->victim_line_pq = pqueue_init(slc_lm->tt_lines, 
-                                            cmp_func, 
-                                            get_func,    
-                                            victim_line_set_pri,
-                                            victim_line_get_pos,
-                                            victim_line_set_pos);
-    }else{
-        tlc_lm->tt_lines = spp->tt_lines;
-        tlc_lm->lines = vmalloc(sizeof(struct line) * tlc_lm->tt_lines);
-    }
-    // 희생 라인 선정을 위한 우선순위 큐 초기화 (Greedy 정책 등 적용)
-    tlc_lm->victim_line_pq = pqueue_init(tlc_lm->tt_lines, 
-                                        cmp_func, 
-                                        get_func,    
-                                        victim_line_set_pri,
-                                        victim_line_get_pos,
-                                        victim_line_set_pos);
+        init_victim_index(slc_lm, cmp_func, get_func);
+    }
+    init_victim_index(tlc_lm, cmp_func, get_func);
+
     INIT_LIST_HEAD(&slc_lm->free_line_list);
     INIT_LIST_HEAD(&tlc_lm->free_line_list);
     INIT_LIST_HEAD(&slc_lm->full_line_list);
     INIT_LIST_HEAD(&tlc_lm->full_line_list);
-    slc_lm->free_line_cnt = 0;
-    tlc_lm->free_line_cnt = 0;
+    slc_lm->free_line_cnt = tlc_lm->free_line_cnt = 0;
+    slc_lm->victim_line_cnt = tlc_lm->victim_line_cnt = 0;
+    slc_lm->full_line_cnt = tlc_lm->full_line_cnt = 0;
+    // 빈 장치에서 시작하므로 SLC는 상한 크기로 시작 (동적 SLC가 꺼져 있으면 상한 = SLC_PORTION)
+    slc_lm->tt_lines = conv_ftl->slc_enabled ? conv_ftl->slc_line_limit : 0;
+    tlc_lm->tt_lines = spp->tt_lines - slc_lm->tt_lines;
+
     for (i = 0; i < spp->tt_lines; i++) { // 모든 라인에 대해 루프
-        if(conv_ftl->slc_enabled && i<slc_lm->tt_lines){
-            slc_lm->lines[i] = (struct line){
-                .id = i, // 라인 ID 설정
-                .ipc = 0, // 무효 페이지 수 0
-                .vpc = 0, // 유효 페이지 수 0
-                .pos = 0, // 큐 위치 0
-                .last_modified_time = 0,
-                .entry = LIST_HEAD_INIT(slc_lm->lines[i].entry), // 리스트 엔트리 초기화
-            };
-            list_add_tail(&slc_lm->lines[i].entry, &slc_lm->free_line_list);
-            slc_lm->free_line_cnt++;
-        }else if(conv_ftl->slc_enabled){
-            int offset = slc_lm->tt_lines;
-            int t = i - offset;
-            tlc_lm->lines[t] = (struct line){
-                .id = i, // 라인 ID 설정
-                .ipc = 0, // 무효 페이지 수 0
-                .vpc = 0, // 유효 페이지 수 0
-                .pos = 0, // 큐 위치 0
-                .last_modified_time = 0, 
-                .entry = LIST_HEAD_INIT(tlc_lm->lines[t].entry), // 리스트 엔트리 초기화
-            };
-            list_add_tail(&tlc_lm->lines[t].entry, &tlc_lm->free_line_list);
-            tlc_lm->free_line_cnt++;
-        }else{
-            tlc_lm->lines[i] = (struct line){
-                .id = i, // 라인 ID 설정
-                .ipc = 0, // 무효 페이지 수 0
-                .vpc = 0, // 유효 페이지 수 0
-                .pos = 0, // 큐 위치 0
-                .last_modified_time = 0, 
-                .entry = LIST_HEAD_INIT(tlc_lm->lines[i].entry), // 리스트 엔트리 초기화
-            };
-            list_add_tail(&tlc_lm->lines[i].entry, &tlc_lm->free_line_list);
-            tlc_lm->free_line_cnt++;
-        }
-    }
-    if (conv_ftl->slc_enabled) {
-        NVMEV_ASSERT(slc_lm->free_line_cnt + tlc_lm->free_line_cnt == spp->tt_lines);
-        slc_lm->victim_line_cnt = 0; // 희생 후보 라인 수 0
-        slc_lm->full_line_cnt = 0; // 꽉 찬 라인 수 0
-        tlc_lm->victim_line_cnt = 0; // 희생 후보 라인 수 0
-        tlc_lm->full_line_cnt = 0; // 꽉 찬 라인 수 0
-    } else {
-        NVMEV_ASSERT(tlc_lm->free_line_cnt == spp->tt_lines);
-        tlc_lm->victim_line_cnt = 0; // 희생 후보 라인 수 0
-        tlc_lm->full_line_cnt = 0; // 꽉 찬 라인 수 0
+        struct line_mgmt *lm = (i < slc_lm->tt_lines) ? slc_lm : tlc_lm;
+
+        line = &conv_ftl->lines[i];
+        *line = (struct line){
+            .id = i, // 라인 ID 설정
+            .ipc = 0, // 무효 페이지 수 0
+            .vpc = 0, // 유효 페이지 수 0
+            .pos = 0, // 큐 위치 0
+            .last_modified_time = 0,
+            .entry = LIST_HEAD_INIT(line->entry), // 리스트 엔트리 초기화
+            .tier_entry = LIST_HEAD_INIT(line->tier_entry),
+            .slc = (lm == slc_lm),
+            .victim = false,
+        };
+        set_line_cell_mode(conv_ftl, line);
+        list_add_tail(&line->entry, &lm->free_line_list);
+        lm->free_line_cnt++;
     }
+    NVMEV_ASSERT(slc_lm->free_line_cnt + tlc_lm->free_line_cnt == spp->tt_lines);
 }
 
 // 라인 관련 메모리 해제 함수
 static void remove_lines(struct conv_ftl *conv_ftl)
 {
-    pqueue_free(conv_ftl->tlc_lm.victim_line_pq); // 우선순위 큐 해제
-    vfree(conv_ftl->tlc_lm.lines); // 라인 구조체 배열 해제
-    if(conv_ftl->slc_enabled){
-        pqueue_free(conv_ftl->slc_lm.victim_line_pq);
-        vfree(conv_ftl->slc_lm.lines);
-    }
+    remove_victim_index(&conv_ftl->tlc_lm); // 우선순위 큐 해제
+    if (conv_ftl->slc_enabled)
+        remove_victim_index(&conv_ftl->slc_lm);
+    vfree(conv_ftl->lines); // 라인 구조체 배열 해제
 }
 
 // 쓰기 유량 제어 초기화 함수
@@ -510,68 +998,49 @@ static inline void check_addr(int a, int max)
 }
 
 // 프리 라인 리스트에서 다음 빈 라인을 가져오는 함수
-static struct line *get_next_free_line(struct conv_ftl *conv_ftl, uint32_t io_type)
+static struct line *get_next_free_line(struct conv_ftl *conv_ftl, struct line_mgmt *lm)
 {
-    struct line_mgmt *lm;
-    if (io_type == GC_IO) {
-        lm = &conv_ftl->tlc_lm;                 // GC는 TLC 강제
-    } else if (io_type == USER_IO) {
-        lm = conv_ftl->slc_enabled ? &conv_ftl->slc_lm : &conv_ftl->tlc_lm;
-    } else {
-        NVMEV_ASSERT(0);
-        return NULL;
-    }
-    
-    struct line *curline = list_first_entry_or_null(&lm->free_line_list,struct line, entry);
-    if (io_type == USER_IO) {
-        pr_info_ratelimited("nvmev: USER alloc line_id=%d from %s (slc_enabled=%d) slc_free=%d tlc_free=%d\n",
-                            curline->id,
-                            (lm == &conv_ftl->slc_lm) ? "SLC" : "TLC",
-                            conv_ftl->slc_enabled,
-                            conv_ftl->slc_lm.free_line_cnt,
-                            conv_ftl->tlc_lm.free_line_cnt);
-    }
+    struct line *curline = list_first_entry_or_null(&lm->free_line_list, struct line, entry);
+
     if (!curline) {
         NVMEV_ERROR("No free line left in VIRT (%s)!!!!\n",
-                    conv_ftl->slc_enabled ? "SLC" : "TLC");
+                    (lm == &conv_ftl->slc_lm) ? "SLC" : "TLC");
         return NULL;
     }
     // 프리 라인 리스트의 첫 번째 항목 가져오기
     list_del_init(&curline->entry);
     lm->free_line_cnt--; 
-    NVMEV_DEBUG("%s: %s free_line_cnt %d\n", __func__,
-                conv_ftl->slc_enabled ? "SLC" : "TLC",
-                lm->free_line_cnt);
+    NVMEV_DEBUG("%s: %s line_id=%d free_line_cnt %d\n", __func__,
+                (lm == &conv_ftl->slc_lm) ? "SLC" : "TLC",
+                curline->id, lm->free_line_cnt);
 
     return curline; // 라인 반환
 }
 
-// IO 타입(유저 IO / GC IO)에 따른 쓰기 포인터 가져오는 함수
-static struct write_pointer *__get_wp(struct conv_ftl *ftl, uint32_t io_type)
+// 유저 쓰기 포인터 선택: SLC 버퍼가 켜져 있으면 SLC, 아니면 스트림(온도)별 TLC 포인터
+static struct write_pointer *__get_user_wp(struct conv_ftl *ftl, uint32_t stream)
 {
-    if (io_type == USER_IO) { // 유저 쓰기인 경우
-        return ftl->slc_enabled ? &ftl->slc_wp : &ftl->tlc_wp; // 유저용 쓰기 포인터 반환
-    } else if (io_type == GC_IO) { // GC 쓰기(Valid Page Copy)인 경우
-        return &ftl->gc_wp; // GC용 쓰기 포인터 반환
-    }
-
-    NVMEV_ASSERT(0); // 알 수 없는 IO 타입이면 에러
-    return NULL;
+    NVMEV_ASSERT(stream < ftl->nr_streams);
+    return ftl->slc_enabled ? &ftl->slc_wp : &ftl->tlc_wp[stream];
 }
 
 // 쓰기 포인터 초기화 및 첫 블록 할당 함수
-static void prepare_write_pointer(struct conv_ftl *conv_ftl, uint32_t io_type)
+// gen: 이 포인터가 여는 라인의 세대 (유저 쓰기 0, GC 세대 i는 i + 1)
+static void prepare_write_pointer(struct conv_ftl *conv_ftl, struct write_pointer *wp,
+                                  struct line_mgmt *lm, uint32_t gen)
 {
-    struct write_pointer *wp = __get_wp(conv_ftl, io_type); // 해당 타입의 포인터 가져오기
-    struct line *curline = get_next_free_line(conv_ftl,io_type); // 새 빈 라인 할당
+    struct line *curline = get_next_free_line(conv_ftl, lm); // 새 빈 라인 할당
 
     NVMEV_ASSERT(wp); // 포인터 유효성 검사
     NVMEV_ASSERT(curline); // 라인 유효성 검사
+    curline->gen = gen;
 
     /* wp->curline is always our next-to-write super-block */
     // 쓰기 포인터 구조체 초기화 (0번 채널, 0번 LUN, 0번 페이지부터 시작)
     *wp = (struct write_pointer){
         .curline = curline,
+        .lm = lm, // 라인이 가득 차면 이 관리자에서 새 라인을 받음
+        .gen = gen,
         .ch = 0,
         .lun = 0,
         .pg = 0,
@@ -580,29 +1049,18 @@ static void prepare_write_pointer(struct conv_ftl *conv_ftl, uint32_t io_type)
     };
 }
 
-// 쓰기 포인터를 다음 위치로 이동시키는 함수 (핵심 로직: 페이지->채널->LUN 순회)
-static void advance_write_pointer(struct conv_ftl *conv_ftl, uint32_t io_type)
+// 쓰기 포인터를 다음 위치로 이동시키는 함수 (핵심 로직: 페이지->플레인->채널->LUN 순회)
+static void advance_write_pointer(struct conv_ftl *conv_ftl, struct write_pointer *wpp)
 {
     struct ssdparams *spp = &conv_ftl->ssd->sp; // SSD 파라미터
-    struct line_mgmt *lm;
-    if(io_type == USER_IO){
-        lm = conv_ftl->slc_enabled ? &conv_ftl->slc_lm : &conv_ftl->tlc_lm;
-    }else if(io_type == GC_IO){
-        //migration시에도 
-        lm = &conv_ftl->tlc_lm;
-    }
-    else{ 
-        NVMEV_ASSERT(0);
-        return;
-    }
+    struct line_mgmt *lm = wpp->lm;
 
-    struct write_pointer *wpp = __get_wp(conv_ftl, io_type); // 현재 쓰기 포인터
     // 디버그용: 현재 포인터 위치 출력
     NVMEV_DEBUG_VERBOSE("current wpp: ch:%d, lun:%d, pl:%d, blk:%d, pg:%d\n",
             wpp->ch, wpp->lun, wpp->pl, wpp->blk, wpp->pg);
 
     int pgs_per_blk, pgs_per_oneshotpg, pgs_per_line;
-    if(io_type == USER_IO && conv_ftl->slc_enabled){
+    if (lm == &conv_ftl->slc_lm) {
         pgs_per_blk = spp->slc_pgs_per_blk;
         pgs_per_oneshotpg = spp->slc_pgs_per_oneshotpg;
         pgs_per_line = spp -> slc_pgs_per_line;
@@ -619,6 +1077,12 @@ static void advance_write_pointer(struct conv_ftl *conv_ftl, uint32_t io_type)
         goto out; // 단순히 페이지만 증가시키고 종료
 
     wpp->pg -= pgs_per_oneshotpg; // 페이지 번호 조정
+    check_addr(wpp->pl, spp->pls_per_lun); // 플레인 주소 검사
+    wpp->pl++; // 같은 LUN의 다음 플레인 (멀티 플레인 프로그램 단위로 모음)
+    if (wpp->pl != spp->pls_per_lun)
+        goto out;
+
+    wpp->pl = 0; // 플레인 0으로 리셋
     check_addr(wpp->ch, spp->nchs); // 채널 주소 검사
     wpp->ch++; // 채널 번호 증가 (채널 인터리빙)
     if (wpp->ch != spp->nchs) // 마지막 채널이 아니면
@@ -650,13 +1114,13 @@ static void advance_write_pointer(struct conv_ftl *conv_ftl, uint32_t io_type)
         NVMEV_ASSERT(wpp->curline->vpc >= 0 && wpp->curline->vpc < pgs_per_line);
         /* there must be some invalid pages in this line */
         NVMEV_ASSERT(wpp->curline->ipc > 0); // 무효 페이지가 반드시 존재해야 함
-        pqueue_insert(lm->victim_line_pq, wpp->curline); // 희생 라인 우선순위 큐에 삽입
-        lm->victim_line_cnt++; // 희생 라인 카운트 증가
+        victim_line_insert(lm, wpp->curline); // 희생 라인 우선순위 큐에 삽입
     }
     /* current line is used up, pick another empty line */
     check_addr(wpp->blk, spp->blks_per_pl); // 블록 주소 검사
-    wpp->curline = get_next_free_line(conv_ftl,io_type); // 새 프리 라인(오픈 블록) 가져오기
+    wpp->curline = get_next_free_line(conv_ftl, lm); // 새 프리 라인(오픈 블록) 가져오기
     NVMEV_DEBUG_VERBOSE("wpp: got new clean line %d\n", wpp->curline->id);
+    wpp->curline->gen = wpp->gen;
 
     wpp->blk = wpp->curline->id; // 새 라인의 ID를 현재 블록으로 설정
     check_addr(wpp->blk, spp->blks_per_pl); // 블록 주소 검사
@@ -666,8 +1130,7 @@ static void advance_write_pointer(struct conv_ftl *conv_ftl, uint32_t io_type)
     NVMEV_ASSERT(wpp->pg == 0);
     NVMEV_ASSERT(wpp->lun == 0);
     NVMEV_ASSERT(wpp->ch == 0);
-    /* TODO: assume # of pl_per_lun is 1, fix later */
-    NVMEV_ASSERT(wpp->pl == 0); // 플레인 0 가정
+    NVMEV_ASSERT(wpp->pl == 0);
 out:
     // 이동 완료 후 현재 위치 출력
     NVMEV_DEBUG_VERBOSE("advanced wpp: ch:%d, lun:%d, pl:%d, blk:%d, pg:%d (curline %d)\n",
@@ -675,10 +1138,9 @@ out:
 }
 
 // 현재 쓰기 포인터 위치를 기반으로 새 페이지(PPA)를 생성하여 반환하는 함수
-static struct ppa get_new_page(struct conv_ftl *conv_ftl, uint32_t io_type)
+static struct ppa get_new_page(struct conv_ftl *conv_ftl, struct write_pointer *wp)
 {
     struct ppa ppa;
-    struct write_pointer *wp = __get_wp(conv_ftl, io_type); // 쓰기 포인터 가져오기
 
     ppa.ppa = 0; // PPA 초기화
     ppa.g.ch = wp->ch; // 현재 채널
@@ -687,20 +1149,51 @@ static struct ppa get_new_page(struct conv_ftl *conv_ftl, uint32_t io_type)
     ppa.g.blk = wp->blk; // 현재 블록
     ppa.g.pl = wp->pl; // 현재 플레인
 
-    NVMEV_ASSERT(ppa.g.pl == 0); // 플레인은 0이어야 함 (단일 플레인 가정)
-    pr_debug_ratelimited("nvmev: new ppa blk(line)=%d io=%s slc=%d\n",
+    pr_debug_ratelimited("nvmev: new ppa blk(line)=%d lm=%s slc=%d\n",
                      ppa.g.blk,
-                     (io_type == USER_IO) ? "USER" : "GC",
+                     (wp->lm == &conv_ftl->slc_lm) ? "SLC" : "TLC",
                      conv_ftl->slc_enabled);
     return ppa; // 생성된 PPA 반환
 }
 
-// 매핑 테이블 초기화 함수
+/*
+ * 지오메트리가 32비트 엔트리에 들어가는지 확인하고 인코딩 정보를 채운다.
+ * PPA 필드 합이 31비트 이하(최상위 비트가 항상 0 -> 예약값과 안 겹침)이고
+ * 파티션 LPN 수가 32비트 예약값보다 작아야 한다.
+ */
+static bool init_ppa_codec(struct conv_ftl *conv_ftl)
+{
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+    struct ppa_codec *c = &conv_ftl->codec;
+    uint32_t ch_bits = order_base_2(spp->nchs);
+
+    c->pg_bits = order_base_2(spp->pgs_per_blk);
+    c->blk_bits = order_base_2(spp->blks_per_pl);
+    c->pl_bits = order_base_2(spp->pls_per_lun);
+    c->lun_bits = order_base_2(spp->luns_per_ch);
+
+    c->blk_shift = c->pg_bits;
+    c->pl_shift = c->blk_shift + c->blk_bits;
+    c->lun_shift = c->pl_shift + c->pl_bits;
+    c->ch_shift = c->lun_shift + c->lun_bits;
+
+    return (c->ch_shift + ch_bits <= 31) && (spp->tt_pgs < LPN32_INVALID);
+}
+
+// 매핑 테이블 초기화 함수
 static void init_maptbl(struct conv_ftl *conv_ftl)
 {
     int i;
     struct ssdparams *spp = &conv_ftl->ssd->sp;
 
+    conv_ftl->compact_map = compact_map && init_ppa_codec(conv_ftl);
+    if (conv_ftl->compact_map) {
+        conv_ftl->maptbl32 = vmalloc(sizeof(uint32_t) * spp->tt_pgs);
+        for (i = 0; i < spp->tt_pgs; i++)
+            conv_ftl->maptbl32[i] = PPA32_UNMAPPED;
+        return;
+    }
+
     conv_ftl->maptbl = vmalloc(sizeof(struct ppa) * spp->tt_pgs); // 전체 페이지 수만큼 할당
     for (i = 0; i < spp->tt_pgs; i++) {
         conv_ftl->maptbl[i].ppa = UNMAPPED_PPA; // 초기값은 '매핑 안됨'으로 설정
@@ -719,6 +1212,14 @@ static void init_rmap(struct conv_ftl *conv_ftl)
     int i;
     struct ssdparams *spp = &conv_ftl->ssd->sp;
 
+    // 형식은 init_maptbl()에서 정해진 compact_map을 따른다
+    if (conv_ftl->compact_map) {
+        conv_ftl->rmap32 = vmalloc(sizeof(uint32_t) * spp->tt_pgs);
+        for (i = 0; i < spp->tt_pgs; i++)
+            conv_ftl->rmap32[i] = LPN32_INVALID;
+        return;
+    }
+
     conv_ftl->rmap = vmalloc(sizeof(uint64_t) * spp->tt_pgs); // 전체 페이지 수만큼 할당
     for (i = 0; i < spp->tt_pgs; i++) {
         conv_ftl->rmap[i] = INVALID_LPN; // 초기값은 '유효하지 않은 LPN'으로 설정
@@ -732,9 +1233,10 @@ static void remove_rmap(struct conv_ftl *conv_ftl)
 }
 
 // FTL 인스턴스 초기화 함수
-static void conv_init_ftl(struct conv_ftl *conv_ftl, struct q *cpp, struct ssd *ssd)
+static void conv_init_ftl(struct conv_ftl *conv_ftl, struct convparams *cpp, struct ssd *ssd)
 {
     struct ssdparams *spp = &ssd->sp;
+    uint32_t i;
     /*copy convparams*/
     conv_ftl->cp = *cpp; // 파라미터 복사
 
@@ -742,32 +1244,92 @@ static void conv_init_ftl(struct conv_ftl *conv_ftl, struct q *cpp, struct ssd *
 
     conv_ftl->slc_enabled = slc_buf; // 모듈에서 세팅한 slc_buf모드로 확정짓기 struct에서 들고 있기
 
+    conv_ftl->slc_grown = 0;
+    conv_ftl->slc_shrunk = 0;
+    conv_ftl->tlc_vpc = 0;
+    conv_ftl->slc_min_lines = conv_ftl->slc_line_limit = conv_ftl->slc_dyn_reserve = 0;
     if (conv_ftl->slc_enabled) {
-        conv_ftl->slc_line_limit = spp->blks_per_pl * SLC_PORTION / 100; //라인 할당
+        conv_ftl->slc_min_lines = spp->slc_tt_lines; // SLC_PORTION 만큼은 항상 SLC
+        conv_ftl->slc_line_limit = conv_ftl->slc_min_lines;
+        // TLC 쪽에는 GC가 돌 수 있을 만큼의 프리 라인을 항상 남김
+        conv_ftl->slc_dyn_reserve = max_t(uint32_t, cpp->gc_thres_lines + 1,
+                spp->tt_lines * slc_dyn_reserve_pcent / 100);
+        if (slc_dyn && spp->tt_lines > conv_ftl->slc_dyn_reserve + 1) {
+            uint32_t limit = min_t(uint32_t, spp->tt_lines * min_t(uint32_t, slc_max_pcent, 100) / 100,
+                    spp->tt_lines - conv_ftl->slc_dyn_reserve - 1);
+
+            conv_ftl->slc_line_limit = max_t(uint32_t, limit, conv_ftl->slc_min_lines);
+        }
     }
     conv_ftl->gc_count = 0;
     conv_ftl->gc_copied_pages = 0;
+    conv_ftl->fg_gc_count = 0;
+    conv_ftl->gc_cur.victim = NULL;
+    conv_ftl->mg_cur.victim = NULL;
+    conv_ftl->incr_gc_steps = 0;
+    conv_ftl->incr_gc_forced = 0;
+    conv_ftl->cb_validate_cnt = 0;
+    conv_ftl->cb_validate_mismatch = 0;
+    memset(&conv_ftl->bg_gc, 0, sizeof(conv_ftl->bg_gc));
+    memset(&conv_ftl->bg_mg, 0, sizeof(conv_ftl->bg_mg));
+    conv_ftl->mg_count = 0;
+    conv_ftl->mg_retained_pgs = 0;
+    conv_ftl->mg_migrated_pgs = 0;
+    conv_ftl->mg_victim_retained = 0;
+    conv_ftl->mg_victim_migrated = 0;
+    conv_ftl->trimmed_pgs = 0;
+    memset(&conv_ftl->seq, 0, sizeof(conv_ftl->seq));
+    spin_lock_init(&conv_ftl->seq_lock);
+    conv_ftl->seq_bypass_pgs = 0;
+    mutex_init(&conv_ftl->lock);
+    conv_ftl->part_worker = NULL;
+    conv_ftl->jqs = NULL;
+    conv_ftl->nr_jqs = 0;
+    init_waitqueue_head(&conv_ftl->job_wq);
+    conv_ftl->pools = NULL;
     /* initialize maptbl */
     init_maptbl(conv_ftl); // 매핑 테이블 할당 및 초기화
 
     /* initialize rmap */
     init_rmap(conv_ftl); // 역매핑 테이블 할당 및 초기화
 
+    /* initialize temperature classifier for user write streams */
+    conv_ftl->nr_streams = conv_nr_streams();
+    conv_ftl->nr_gc_gens = conv_nr_gc_gens();
+    memset(conv_ftl->gc_gen_copied, 0, sizeof(conv_ftl->gc_gen_copied));
+    memset(conv_ftl->stream_user_pgs, 0, sizeof(conv_ftl->stream_user_pgs));
+    memset(conv_ftl->stream_gc_pgs, 0, sizeof(conv_ftl->stream_gc_pgs));
+    memset(conv_ftl->stream_retained_pgs, 0, sizeof(conv_ftl->stream_retained_pgs));
+    init_lpn_heat(conv_ftl);
+
     /* initialize all the lines */
     init_lines(conv_ftl); // 라인 관리 구조체 초기화
 
+    if (conv_ftl->slc_enabled)
+        update_mg_watermark(conv_ftl);
+
     /* initialize write pointer, this is how we allocate new pages for writes */
-    prepare_write_pointer(conv_ftl, USER_IO); // 유저 쓰기 포인터 준비
-    prepare_write_pointer(conv_ftl, GC_IO);   // GC 쓰기 포인터 준비
+    // 유저 쓰기 포인터 준비: 스트림 수만큼 TLC 오픈 라인, SLC 버퍼 모드는 SLC 하나 추가
+    // (SLC 버퍼 모드의 TLC 유저 포인터는 순차 스트림 우회에 사용)
+    if (conv_ftl->slc_enabled)
+        prepare_write_pointer(conv_ftl, &conv_ftl->slc_wp, &conv_ftl->slc_lm, 0);
+    for (i = 0; i < conv_ftl->nr_streams; i++)
+        prepare_write_pointer(conv_ftl, &conv_ftl->tlc_wp[i], &conv_ftl->tlc_lm, 0);
+    // GC 쓰기 포인터 준비: 세대마다 하나씩
+    for (i = 0; i < conv_ftl->nr_gc_gens; i++)
+        prepare_write_pointer(conv_ftl, &conv_ftl->gc_wp[i], &conv_ftl->tlc_lm, i + 1);
 
     init_write_flow_control(conv_ftl); // 쓰기 유량 제어 초기화
 
     // 초기화 완료 로그 출력
     NVMEV_INFO("Init FTL instance with %d channels (%ld pages)\n", conv_ftl->ssd->sp.nchs,
            conv_ftl->ssd->sp.tt_pgs);
-    NVMEV_INFO("SLC: slc_buf=%d slc_enabled=%d slc_lines=%d tlc_lines=%d\n",
+    NVMEV_INFO("SLC: slc_buf=%d slc_enabled=%d slc_lines=%d tlc_lines=%d (dynamic %u..%u, reserve %u)\n",
            slc_buf, conv_ftl->slc_enabled,
-           conv_ftl->slc_lm.tt_lines, conv_ftl->tlc_lm.tt_lines);
+           conv_ftl->slc_lm.tt_lines, conv_ftl->tlc_lm.tt_lines,
+           conv_ftl->slc_min_lines, conv_ftl->slc_line_limit, conv_ftl->slc_dyn_reserve);
+    NVMEV_INFO("Streams: %u user streams, chunk %u LPNs, decay every %llu pages\n",
+           conv_ftl->nr_streams, 1U << stream_chunk_shift, conv_ftl->heat_decay_pgs);
 
     return;
 }
@@ -777,6 +1339,7 @@ static void conv_remove_ftl(struct conv_ftl *conv_ftl)
 {
     remove_lines(conv_ftl); // 라인 해제
     remove_rmap(conv_ftl);  // 역매핑 테이블 해제
+    remove_lpn_heat(conv_ftl); // 온도 분류기 해제
     remove_maptbl(conv_ftl); // 매핑 테이블 해제
 }
 
@@ -784,8 +1347,10 @@ static void conv_remove_ftl(struct conv_ftl *conv_ftl)
 static void conv_init_params(struct convparams *cpp)
 {
     cpp->op_area_pcent = OP_AREA_PERCENT; // 오버 프로비저닝 비율
-    cpp->gc_thres_lines = 2; /* Need only two lines.(host write, gc)*/ // GC 시작 임계값 (최소 2개)
-    cpp->gc_thres_lines_high = 2; /* Need only two lines.(host write, gc)*/ // 긴급 GC 임계값
+    // 유저 스트림마다 오픈 라인 하나 + GC 세대마다 오픈 라인 하나
+    cpp->gc_thres_lines_high = conv_nr_streams() + conv_nr_gc_gens(); // 긴급 GC 임계값
+    // 백그라운드 GC 시작 임계값 (긴급 임계값보다 작으면 의미가 없음)
+    cpp->gc_thres_lines = max_t(uint32_t, bg_gc_thres_lines, cpp->gc_thres_lines_high);
     cpp->enable_gc_delay = 1; // GC 지연 시뮬레이션 활성화
     
     cpp->mg_thres_lines = 2;
@@ -796,6 +1361,147 @@ static void conv_init_params(struct convparams *cpp)
     cpp->slc_pba_pcent = (int)((1 + cpp->op_area_pcent) * 100 * SLC_PORTION / 100);
 }
 
+static void conv_free_cmd_pools(struct conv_ftl *owner, uint32_t nr_pools)
+{
+    uint32_t i;
+
+    if (!owner->pools)
+        return;
+
+    for (i = 0; i < nr_pools; i++)
+        vfree(owner->pools[i].cmds);
+    kfree(owner->pools);
+    owner->pools = NULL;
+}
+
+// 결과를 미룬 명령의 컨텍스트 풀 (디스패처마다 하나, 0번 파티션이 소유)
+static bool conv_alloc_cmd_pools(struct conv_ftl *owner, uint32_t nr_pools)
+{
+    uint32_t i, j;
+
+    owner->pools = kcalloc(nr_pools, sizeof(struct conv_cmd_pool), GFP_KERNEL);
+    if (!owner->pools)
+        return false;
+
+    for (i = 0; i < nr_pools; i++) {
+        struct conv_cmd_pool *pool = &owner->pools[i];
+
+        pool->cmds = vzalloc(sizeof(struct conv_cmd) * CONV_MAX_PENDING_CMDS);
+        if (!pool->cmds) {
+            conv_free_cmd_pools(owner, nr_pools);
+            return false;
+        }
+
+        pool->free_cmds = NULL;
+        for (j = 0; j < CONV_MAX_PENDING_CMDS; j++) {
+            pool->cmds[j].next = pool->free_cmds;
+            pool->free_cmds = &pool->cmds[j];
+        }
+    }
+    return true;
+}
+
+static void conv_free_job_queues(struct conv_ftl *conv_ftl)
+{
+    uint32_t i;
+
+    if (!conv_ftl->jqs)
+        return;
+
+    for (i = 0; i < conv_ftl->nr_jqs; i++)
+        vfree(conv_ftl->jqs[i].jobs);
+    kfree(conv_ftl->jqs);
+    conv_ftl->jqs = NULL;
+    conv_ftl->nr_jqs = 0;
+}
+
+// 디스패처별 작업 큐 (파티션 스레드의 NUMA 노드에 할당)
+static bool conv_alloc_job_queues(struct conv_ftl *conv_ftl, uint32_t nr_jqs, int node)
+{
+    uint32_t i;
+
+    conv_ftl->jqs = kcalloc_node(nr_jqs, sizeof(struct conv_job_queue), GFP_KERNEL, node);
+    if (!conv_ftl->jqs)
+        return false;
+
+    conv_ftl->nr_jqs = nr_jqs;
+    for (i = 0; i < nr_jqs; i++) {
+        conv_ftl->jqs[i].jobs =
+                vzalloc_node(sizeof(struct conv_part_job) * CONV_PART_QUEUE_DEPTH, node);
+        if (!conv_ftl->jqs[i].jobs) {
+            conv_free_job_queues(conv_ftl);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * ftl_cpus 목록의 i번째 CPU에 i번 파티션 스레드를 띄운다.
+ * 목록이 파티션 수보다 짧으면 남는 파티션은 디스패처에서 실행된다.
+ * 디스패처마다 파티션별 작업 큐와 명령 컨텍스트 풀을 따로 두고,
+ * 끝난 작업은 작업을 넣은 디스패처가 회수한다 (IO 워커 큐는 담당 디스패처만 쓸 수 있다).
+ */
+static void conv_start_part_workers(struct conv_ftl *conv_ftls, uint32_t nr_parts, uint32_t id)
+{
+    const uint32_t nr_dispatchers = nvmev_vdev->config.nr_dispatchers;
+    char *cpus, *cpu, *p;
+    uint32_t i = 0;
+
+    if (!ftl_cpus || !*ftl_cpus)
+        return;
+
+    if (!conv_alloc_cmd_pools(&conv_ftls[0], nr_dispatchers)) {
+        NVMEV_ERROR("Failed to allocate FTL command contexts\n");
+        return;
+    }
+
+    p = cpus = kstrdup(ftl_cpus, GFP_KERNEL);
+    if (!cpus)
+        return;
+
+    while ((cpu = strsep(&p, ",")) != NULL && i < nr_parts) {
+        struct conv_ftl *conv_ftl = &conv_ftls[i];
+        unsigned int cpu_nr = (unsigned int)simple_strtol(cpu, NULL, 10);
+        struct task_struct *task;
+
+        if (!conv_alloc_job_queues(conv_ftl, nr_dispatchers, cpu_to_node(cpu_nr))) {
+            NVMEV_ERROR("Failed to allocate job queues for partition %u\n", i);
+            break;
+        }
+
+        task = kthread_create(conv_part_worker, conv_ftl, "nvmev_ftl_%u_%u", id, i);
+        if (IS_ERR(task)) {
+            NVMEV_ERROR("Failed to create FTL thread for partition %u\n", i);
+            conv_free_job_queues(conv_ftl);
+            break;
+        }
+        kthread_bind(task, cpu_nr);
+        conv_ftl->part_worker = task;
+        wake_up_process(task);
+
+        NVMEV_INFO("FTL partition %u of namespace %u runs on cpu %u\n", i, id, cpu_nr);
+        i++;
+    }
+
+    kfree(cpus);
+}
+
+static void conv_stop_part_workers(struct conv_ftl *conv_ftls, uint32_t nr_parts)
+{
+    uint32_t i;
+
+    for (i = 0; i < nr_parts; i++) {
+        if (!conv_ftls[i].part_worker)
+            continue;
+        kthread_stop(conv_ftls[i].part_worker);
+        conv_ftls[i].part_worker = NULL;
+        conv_free_job_queues(&conv_ftls[i]);
+    }
+
+    conv_free_cmd_pools(&conv_ftls[0], nvmev_vdev->config.nr_dispatchers);
+}
+
 // 네임스페이스(NVMe Namespace) 초기화 함수
 void conv_init_namespace(struct nvmev_ns *ns, uint32_t id, uint64_t size, void *mapped_addr,
              uint32_t cpu_nr_dispatcher)
@@ -814,14 +1520,15 @@ void conv_init_namespace(struct nvmev_ns *ns, uint32_t id, uint64_t size, void *
 
     for (i = 0; i < nr_parts; i++) { // 각 파티션마다 루프
         ssd = kmalloc(sizeof(struct ssd), GFP_KERNEL); // SSD 구조체 할당
-        ssd_init(ssd, &spp, cpu_nr_dispatcher); // SSD 초기화
+        NVMEV_ASSERT(ssd && ssd_init(ssd, &spp, cpu_nr_dispatcher) == 0); // SSD 초기화
         conv_init_ftl(&conv_ftls[i], &cpp, ssd); // FTL 초기화
     }
 
     /* PCIe, Write buffer are shared by all instances*/
     // PCIe 인터페이스와 쓰기 버퍼는 모든 인스턴스가 공유함
     for (i = 1; i < nr_parts; i++) {
-        kfree(conv_ftls[i].ssd->pcie->perf_model); // 중복 할당된 것 해제
+        chmodel_exit(conv_ftls[i].ssd->pcie->perf_model); // 중복 할당된 것 해제
+        kfree(conv_ftls[i].ssd->pcie->perf_model);
         kfree(conv_ftls[i].ssd->pcie);
         kfree(conv_ftls[i].ssd->write_buffer);
 
@@ -837,10 +1544,19 @@ void conv_init_namespace(struct nvmev_ns *ns, uint32_t id, uint64_t size, void *
     ns->mapped = mapped_addr; // 매핑된 주소
     /*register io command handler*/
     ns->proc_io_cmd = conv_proc_nvme_io_cmd; // IO 처리 핸들러 등록
+    ns->proc_idle = conv_proc_idle; // 유휴 시간 처리 핸들러 등록 (백그라운드 GC)
+    ns->proc_pending = conv_proc_pending; // 파티션 스레드에 맡긴 명령 마무리
+    ns->concurrent = true; // 파티션 잠금으로 보호하므로 디스패처들이 동시에 들어와도 된다
+
+    conv_start_part_workers(conv_ftls, nr_parts, id); // 파티션 전용 스레드 (ftl_cpus)
 
     // 정보 출력 로그
     NVMEV_INFO("FTL physical space: %lld, logical space: %lld (physical/logical * 100 = %d)\n",
            size, ns->size, cpp.pba_pcent);
+    NVMEV_INFO("FTL mapping entries: %s (%lu KiB per partition)\n",
+           conv_ftls[0].compact_map ? "32-bit" : "64-bit",
+           (conv_ftls[0].compact_map ? 2 * sizeof(uint32_t) : sizeof(struct ppa) + sizeof(uint64_t)) *
+                   spp.tt_pgs / 1024);
 
     return;
 }
@@ -852,6 +1568,8 @@ void conv_remove_namespace(struct nvmev_ns *ns)
     const uint32_t nr_parts = SSD_PARTITIONS;
     uint32_t i;
 
+    conv_stop_part_workers(conv_ftls, nr_parts);
+
     /* PCIe, Write buffer are shared by all instances*/
     for (i = 1; i < nr_parts; i++) {
         /*
@@ -916,13 +1634,13 @@ static inline bool mapped_ppa(struct ppa *ppa)
 // PPA에 해당하는 라인(블록) 포인터를 가져오는 함수
 static inline struct line *get_line(struct conv_ftl *conv_ftl, struct ppa *ppa)
 {
-    int line_id = ppa->g.blk; // 너 구조에선 blk==line_id로 쓰고 있음
-    if (conv_ftl->slc_enabled && line_id < conv_ftl->slc_lm.tt_lines) {
-        return &conv_ftl->slc_lm.lines[line_id];
-    } else {
-        int off = conv_ftl->slc_enabled ? conv_ftl->slc_lm.tt_lines : 0;
-        return &conv_ftl->tlc_lm.lines[line_id - off];
-    }
+    return &conv_ftl->lines[ppa->g.blk]; // blk == line_id
+}
+
+// 라인의 현재 모드에 해당하는 라인 관리자
+static inline struct line_mgmt *line_lm(struct conv_ftl *conv_ftl, struct line *line)
+{
+    return line->slc ? &conv_ftl->slc_lm : &conv_ftl->tlc_lm;
 }
 
 /* update SSD status about one page from PG_VALID -> PG_VALID */
@@ -949,23 +1667,22 @@ static void mark_page_invalid(struct conv_ftl *conv_ftl, struct ppa *ppa)
 
     /* update corresponding line status */
     line = get_line(conv_ftl, ppa); // 라인 가져오기
-    struct line_mgmt *lm;
-    if(conv_ftl->slc_enabled && line->id < conv_ftl->slc_lm.tt_lines){
-        lm = &conv_ftl->slc_lm;
-    }else{
-        lm = &conv_ftl->tlc_lm;
-    }
+    struct line_mgmt *lm = line_lm(conv_ftl, line);
     NVMEV_ASSERT(line->ipc >= 0 && line->ipc < spp->pgs_per_line);
-    if (line->vpc == spp->pgs_per_line) { // 기존에 꽉 찬 라인(Full Line)이었다면
+    // full 리스트에 있던 라인만 (마이그레이션 중인 full 라인은 리스트에서 빠져 있음)
+    if (line->vpc == lm_pgs_per_line(conv_ftl, lm) && !list_empty(&line->entry)) {
         NVMEV_ASSERT(line->ipc == 0);
         was_full_line = true; // 플래그 설정
     }
     line->ipc++; // 라인 무효 페이지 증가
     NVMEV_ASSERT(line->vpc > 0 && line->vpc <= spp->pgs_per_line);
+    if (!line->slc)
+        conv_ftl->tlc_vpc--;
+    // CB 인덱스가 새 시각 기준으로 Tier를 정하도록 큐 조작 전에 갱신
+    line->last_modified_time = ktime_get_ns();
     /* Adjust the position of the victime line in the pq under over-writes */
     if (line->pos) { // 이미 우선순위 큐(Victim List)에 있다면
-        /* Note that line->vpc will be updated by this call */
-        pqueue_change_priority(lm->victim_line_pq, line->vpc - 1, line); // 우선순위(VPC) 갱신
+        victim_line_invalidate_one(lm, line); // 우선순위(VPC) 갱신
     } else {
         line->vpc--; // 큐에 없으면 VPC만 감소
     }
@@ -974,10 +1691,8 @@ static void mark_page_invalid(struct conv_ftl *conv_ftl, struct ppa *ppa)
         /* move line: "full" -> "victim" */
         list_del_init(&line->entry); // 리스트에서 제거
         lm->full_line_cnt--; // Full 라인 수 감소
-        pqueue_insert(lm->victim_line_pq, line); // Victim 우선순위 큐로 이동
-        lm->victim_line_cnt++; // Victim 라인 수 증가
+        victim_line_insert(lm, line); // Victim 우선순위 큐로 이동
     }
-    line->last_modified_time = ktime_get_ns(); 
 }
 
 // 페이지를 유효화(Valid) 처리하는 함수 (새 데이터 쓰기 시)
@@ -1002,6 +1717,8 @@ static void mark_page_valid(struct conv_ftl *conv_ftl, struct ppa *ppa)
     line = get_line(conv_ftl, ppa); // 라인 가져오기
     NVMEV_ASSERT(line->vpc >= 0 && line->vpc < spp->pgs_per_line);
     line->vpc++; // 라인 유효 페이지 수 증가
+    if (!line->slc)
+        conv_ftl->tlc_vpc++;
 }
 
 // 블록을 프리(Free) 상태로 초기화하는 함수 (Erase 수행 시)
@@ -1024,6 +1741,8 @@ static void mark_block_free(struct conv_ftl *conv_ftl, struct ppa *ppa)
     blk->ipc = 0; // 무효 페이지 수 리셋
     blk->vpc = 0; // 유효 페이지 수 리셋
     blk->erase_cnt++; // 지우기 횟수(Erase Count) 증가
+    // 데이터 나이 초기화. 지우기 지연을 시뮬레이션하지 않는 경로도 여기를 지나므로 여기서 비운다
+    blk->prog_time = 0;
 }
 
 // GC 과정에서 페이지를 읽는 함수
@@ -1045,45 +1764,99 @@ static void gc_read_page(struct conv_ftl *conv_ftl, struct ppa *ppa)
     }
 }
 
+// 희생 라인의 세대에 따라 복사 목적지 GC 쓰기 포인터 선택
+// 세대 g 라인(g번 재배치된 데이터)의 페이지는 gc_wp[g]로 가서 g + 1 세대가 됨 (마지막 세대는 유지)
+static struct write_pointer *__get_gc_wp(struct conv_ftl *conv_ftl, struct line *victim)
+{
+    return &conv_ftl->gc_wp[min_t(uint32_t, victim->gen, conv_ftl->nr_gc_gens - 1)];
+}
+
+// GC(GC_IO)와 마이그레이션(MIG_IO)은 각자의 지연 시뮬레이션 설정을 따른다
+static inline bool io_delay_enabled(struct conv_ftl *conv_ftl, int io_type)
+{
+    return (io_type == MIG_IO) ? conv_ftl->cp.enable_mg_delay : conv_ftl->cp.enable_gc_delay;
+}
+
+// 마이그레이션 중인 페이지를 SLC에 남길지 결정 (Hot이고, 라인당 한도와 SLC 프리 라인 여유가 있을 때)
+static bool mg_retain_page(struct conv_ftl *conv_ftl, uint64_t lpn)
+{
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+    uint32_t limit = spp->slc_pgs_per_line * min_t(uint32_t, mg_retain_max_pcent, 100) / 100;
+
+    if (!mg_hot_thres || !conv_ftl->heat || conv_ftl->mg_victim_retained >= limit)
+        return false;
+    /*
+     * 프리 라인은 유저 쓰기 몫으로 mg_thres_lines_high개를 남겨 둔다.
+     * 유지분이 마지막 프리 라인을 가져가면 증분 정리 중 유저 쓰기가 받을 라인이 없다.
+     */
+    if (conv_ftl->slc_lm.free_line_cnt <= conv_ftl->cp.mg_thres_lines_high)
+        return false;
+    return get_lpn_heat(conv_ftl, lpn)->cnt >= mg_hot_thres;
+}
+
 /* move valid page data (already in DRAM) from victim line to a new page */
 // GC 과정에서 유효 페이지를 새 위치로 쓰는(복사하는) 함수
-static uint64_t gc_write_page(struct conv_ftl *conv_ftl, struct ppa *old_ppa)
+// read_done: 이 페이지를 읽어 온 GC 읽기의 완료 시각 (원샷 프로그램은 이보다 먼저 시작할 수 없음)
+static uint64_t gc_write_page(struct conv_ftl *conv_ftl, struct ppa *old_ppa, int io_type,
+                              uint64_t read_done)
 {
     struct ssdparams *spp = &conv_ftl->ssd->sp;
-    struct convparams *cpp = &conv_ftl->cp;
     struct ppa new_ppa;
     uint64_t lpn = get_rmap_ent(conv_ftl, old_ppa); // 구 주소의 LPN 확인
+    bool retain = (io_type == MIG_IO) && mg_retain_page(conv_ftl, lpn);
+    struct write_pointer *wp = retain ? &conv_ftl->slc_wp
+                                      : __get_gc_wp(conv_ftl, get_line(conv_ftl, old_ppa));
 
     NVMEV_ASSERT(valid_lpn(conv_ftl, lpn)); // LPN 유효성 확인
-    new_ppa = get_new_page(conv_ftl, GC_IO); // GC용 새 페이지(Open Block) 할당
-    pr_info_ratelimited("nvmev: GC new_ppa blk=%d (should be TLC area) slc_tt=%d\n",
-                    new_ppa.g.blk, conv_ftl->slc_lm.tt_lines);
+    new_ppa = get_new_page(conv_ftl, wp); // GC용 새 페이지(Open Block) 할당
+    NVMEV_ASSERT(wp->curline->slc == retain); // Hot 유지분만 SLC, 나머지는 항상 TLC
     /* update maptbl */
     set_maptbl_ent(conv_ftl, lpn, &new_ppa); // 매핑 테이블을 새 주소로 갱신
     /* update rmap */
     set_rmap_ent(conv_ftl, lpn, &new_ppa); // 역매핑 테이블 갱신
 
     mark_page_valid(conv_ftl, &new_ppa); // 새 페이지를 유효 상태로 마킹
-    /* GC로 복사된 페이지 수 증가 */
-    conv_ftl->gc_copied_pages++;
+    if (retain) {
+        // SLC에 다시 쓴 Hot 페이지는 GC 복사/WAF와 따로 집계
+        conv_ftl->mg_victim_retained++;
+        conv_ftl->stream_retained_pgs[get_lpn_stream(conv_ftl, lpn)]++;
+        /*
+         * 증분 모드는 mg_begin() 직후 라인 전체 크레딧을 미리 채워 두므로,
+         * 다시 쓴 페이지만큼 그 자리에서 유저 크레딧을 뺀다.
+         */
+        if (incr_gc)
+            conv_ftl->slc_wfc.write_credits--;
+    } else {
+        /* GC로 복사된 페이지 수 증가 */
+        conv_ftl->gc_copied_pages++;
+        conv_ftl->stream_gc_pgs[get_lpn_stream(conv_ftl, lpn)]++; // 스트림별 WAF 집계
+        conv_ftl->gc_gen_copied[wp->gen - 1]++; // 세대별 복사 수 집계
+        if (io_type == MIG_IO)
+            conv_ftl->mg_victim_migrated++;
+    }
 
     /* need to advance the write pointer here */
-    advance_write_pointer(conv_ftl, GC_IO); // GC 쓰기 포인터 전진
-
-    if (cpp->enable_gc_delay) { // 지연 시뮬레이션
-        struct nand_cmd gcw = {
-            .type = GC_IO,
-            .cmd = NAND_NOP, // 기본은 NOP
-            .stime = 0,
-            .interleave_pci_dma = false,
-            .ppa = &new_ppa,
-        };
-        if (last_pg_in_wordline(conv_ftl, &new_ppa,GC_IO)) { // 워드라인 끝이면 실제 쓰기 명령 수행
-            gcw.cmd = NAND_WRITE;
-            gcw.xfer_size = spp->pgsz * spp->pgs_per_oneshotpg;
+    advance_write_pointer(conv_ftl, wp); // GC 쓰기 포인터 전진
+
+    /*
+     * 유효 페이지는 원샷 단위가 찰 때까지 모았다가 한 번에 프로그램한다.
+     * 프로그램은 모인 데이터의 읽기가 모두 끝난 뒤 시작하므로, 다른 LUN에서의 읽기와
+     * 이 LUN의 프로그램이 자연스럽게 겹친다 (쓰기 포인터가 원샷마다 ch/LUN을 옮겨 감).
+     */
+    wp->gather_stime = max(wp->gather_stime, read_done);
+    if (last_pg_in_wordline(conv_ftl, &new_ppa, wp)) {
+        if (io_delay_enabled(conv_ftl, io_type)) { // 지연 시뮬레이션
+            struct nand_cmd gcw = {
+                .type = io_type,
+                .cmd = NAND_WRITE,
+                .stime = wp->gather_stime,
+                .xfer_size = wp_program_size(conv_ftl, wp),
+                .interleave_pci_dma = false,
+                .ppa = &new_ppa,
+            };
+            ssd_advance_nand(conv_ftl->ssd, &gcw); // 명령 전달
         }
-
-        ssd_advance_nand(conv_ftl->ssd, &gcw); // 명령 전달
+        wp->gather_stime = 0;
     }
 
     /* advance per-ch gc_endtime as well */
@@ -1114,7 +1887,7 @@ static void clean_one_block(struct conv_ftl *conv_ftl, struct ppa *ppa)
         if (pg_iter->status == PG_VALID) { // 유효 페이지라면
             gc_read_page(conv_ftl, ppa); // 읽고
             /* delay the maptbl update until "write" happens */
-            gc_write_page(conv_ftl, ppa); // 다른 곳에 씀 (Copy)
+            gc_write_page(conv_ftl, ppa, GC_IO, 0); // 다른 곳에 씀 (Copy)
             cnt++; // 복사한 페이지 수 카운트
         }
     }
@@ -1124,10 +1897,9 @@ static void clean_one_block(struct conv_ftl *conv_ftl, struct ppa *ppa)
 
 /* here ppa identifies the block we want to clean */
 // 하나의 플래시 페이지 단위로 청소하는 함수
-static void clean_one_flashpg(struct conv_ftl *conv_ftl, struct ppa *ppa)
+static void clean_one_flashpg(struct conv_ftl *conv_ftl, struct ppa *ppa, int io_type)
 {
     struct ssdparams *spp = &conv_ftl->ssd->sp;
-    struct convparams *cpp = &conv_ftl->cp;
     struct nand_page *pg_iter = NULL;
     int cnt = 0, i = 0;
     uint64_t completed_time = 0;
@@ -1148,9 +1920,9 @@ static void clean_one_flashpg(struct conv_ftl *conv_ftl, struct ppa *ppa)
     if (cnt <= 0) // 유효 페이지 없으면 리턴
         return;
 
-    if (cpp->enable_gc_delay) { // 읽기 지연 시뮬레이션
+    if (io_delay_enabled(conv_ftl, io_type)) { // 읽기 지연 시뮬레이션
         struct nand_cmd gcr = {
-            .type = GC_IO,
+            .type = io_type,
             .cmd = NAND_READ,
             .stime = 0,
             .xfer_size = spp->pgsz * cnt,
@@ -1166,19 +1938,36 @@ static void clean_one_flashpg(struct conv_ftl *conv_ftl, struct ppa *ppa)
         /* there shouldn't be any free page in victim blocks */
         if (pg_iter->status == PG_VALID) {
             /* delay the maptbl update until "write" happens */
-            gc_write_page(conv_ftl, &ppa_copy); // 유효 페이지 복사 해당연산이 코스트에 해당한다고 볼 수 있기 때문에
+            gc_write_page(conv_ftl, &ppa_copy, io_type, completed_time); // 유효 페이지 복사 해당연산이 코스트에 해당한다고 볼 수 있기 때문에
         }
 
         ppa_copy.g.pg++;
     }
 }
 
-// GC가 끝난 라인을 프리 라인 리스트로 되돌리는 함수
+// GC가 끝난 라인을 프리 라인 리스트로 되돌리는 함수 (지워진 시점에 SLC/TLC 모드 재결정)
 static void mark_line_free(struct conv_ftl *conv_ftl, struct ppa *ppa, struct line_mgmt *lm)
 {
     struct line *line = get_line(conv_ftl, ppa); // 라인 가져오기
+    bool slc = want_slc_line(conv_ftl, line->slc);
+
+    NVMEV_ASSERT(lm == line_lm(conv_ftl, line));
     line->ipc = 0; // 무효 카운트 초기화
     line->vpc = 0; // 유효 카운트 초기화
+    if (slc != line->slc) {
+        lm->tt_lines--;
+        line->slc = slc;
+        set_line_cell_mode(conv_ftl, line); // 지워진 블록이므로 여기서 모드 전환
+        lm = line_lm(conv_ftl, line);
+        lm->tt_lines++;
+        if (slc)
+            conv_ftl->slc_grown++;
+        else
+            conv_ftl->slc_shrunk++;
+        update_mg_watermark(conv_ftl);
+        NVMEV_DEBUG("%s: line %d -> %s (slc=%u tlc=%u)\n", __func__, line->id,
+                slc ? "SLC" : "TLC", conv_ftl->slc_lm.tt_lines, conv_ftl->tlc_lm.tt_lines);
+    }
     /* move this line to free line list */
     list_add_tail(&line->entry, &lm->free_line_list); // 프리 라인 리스트 끝에 추가
     lm->free_line_cnt++; // 프리 라인 수 증가
@@ -1194,8 +1983,8 @@ static void count_gc_victim_type(struct conv_ftl *conv_ftl, struct line *victim)
     // 유효 페이지가 하나도 없다는 건, 쓰자마자 지워진 "초(Ultra) Hot" 데이터일 확률이 높습니다.
     // 카피할 게 없어서 GC가 제일 좋아하는 상황입니다. 이것도 Hot으로 쳐줍니다.
     if (victim->vpc == 0) {
-        hot_gc_cnt++;
-        total_gc_cnt++;
+        atomic64_inc(&hot_gc_cnt);
+        atomic64_inc(&total_gc_cnt);
         return;
     }
 
@@ -1228,144 +2017,225 @@ static void count_gc_victim_type(struct conv_ftl *conv_ftl, struct line *victim)
         return; 
     }
 
-    total_gc_cnt++;
+    atomic64_inc(&total_gc_cnt);
 
     // [5] 판별 로직
     if (check_lpn < HOT_REGION_LPN_LIMIT) {
-        hot_gc_cnt++; // 🔥 Hot 영역
+        atomic64_inc(&hot_gc_cnt); // 🔥 Hot 영역
     } else {
-        cold_gc_cnt++; // 🧊 Cold 영역
+        atomic64_inc(&cold_gc_cnt); // 🧊 Cold 영역
     }
 }
-// 실제 GC를 수행하는 메인 함수
-static int do_mg(struct conv_ftl *conv_ftl, bool force)
+// 라인 관리자(SLC/TLC)에 따른 블록당 플래시 페이지 수
+static inline uint32_t lm_flashpgs_per_blk(struct conv_ftl *conv_ftl, struct line_mgmt *lm)
+{
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+
+    return (lm == &conv_ftl->slc_lm) ? spp->slc_flashpgs_per_blk : spp->flashpgs_per_blk;
+}
+
+// 라인 하나를 정리하는 데 필요한 스텝 수 (flashpg x ch x lun x pl)
+static inline uint32_t gc_nr_steps(struct conv_ftl *conv_ftl, struct line_mgmt *lm)
+{
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+
+    return lm_flashpgs_per_blk(conv_ftl, lm) * spp->nchs * spp->luns_per_ch * spp->pls_per_lun;
+}
+
+/*
+ * 커서의 희생 라인을 최대 nr_steps 스텝 정리한다.
+ * 한 스텝 = 한 플레인의 플래시 페이지 하나 (clean_one_flashpg), 마지막 플래시 페이지
+ * 스텝에서는 해당 블록을 지운다 (지우기 명령은 LUN의 마지막 플레인에서 멀티 플레인으로 한 번).
+ * 라인 정리가 끝나면 프리 리스트로 돌리고 true.
+ */
+static bool gc_run_steps(struct conv_ftl *conv_ftl, struct gc_cursor *cur, uint32_t nr_steps)
 {
-    struct line *victim_line = NULL;
     struct ssdparams *spp = &conv_ftl->ssd->sp;
+    bool mg = (cur->lm == &conv_ftl->slc_lm);
+    int io_type = mg ? MIG_IO : GC_IO;
+    uint32_t total = gc_nr_steps(conv_ftl, cur->lm);
+    uint32_t flashpgs_per_blk = lm_flashpgs_per_blk(conv_ftl, cur->lm);
+    uint32_t luns = spp->luns_per_ch;
+    uint32_t pls = spp->pls_per_lun;
+    uint32_t steps_per_flashpg = spp->nchs * luns * pls;
     struct ppa ppa;
-    int flashpg;
 
-    victim_line = conv_ftl->slc_lm.select_victim(conv_ftl, force);
+    ppa.ppa = 0;
+    ppa.g.blk = cur->victim->id; // 선택된 라인 ID를 블록 주소로 설정
+
+    /* copy back valid data */
+    // (flashpg, ch, lun, pl) 순서로 스텝을 진행하며 유효 데이터 이동
+    while (nr_steps-- > 0 && cur->next_step < total) {
+        uint32_t step = cur->next_step++;
+        uint32_t flashpg = step / steps_per_flashpg;
+        struct nand_lun *lunp;
+
+        ppa.g.pg = flashpg * spp->pgs_per_flashpg;
+        ppa.g.ch = (step % steps_per_flashpg) / (luns * pls);
+        ppa.g.lun = (step / pls) % luns;
+        ppa.g.pl = step % pls;
+        lunp = get_lun(conv_ftl->ssd, &ppa);
+        clean_one_flashpg(conv_ftl, &ppa, io_type); // 해당 페이지 청소(복사)
+
+        if (flashpg == (flashpgs_per_blk - 1)) { // 마지막 페이지라면 (블록 비우기 완료)
+            mark_block_free(conv_ftl, &ppa); // 블록 상태를 Free로 변경 (메타데이터)
+
+            // 같은 LUN의 모든 플레인 블록을 한 번의 멀티 플레인 지우기로 처리
+            if (ppa.g.pl == pls - 1 && io_delay_enabled(conv_ftl, io_type)) { // Erase 지연 시뮬레이션
+                struct nand_cmd gce = {
+                    .type = io_type,
+                    .cmd = NAND_ERASE, // 지우기 명령
+                    .stime = 0,
+                    .interleave_pci_dma = false,
+                    .ppa = &ppa,
+                };
+                ssd_advance_nand(conv_ftl->ssd, &gce);
+            }
+
+            lunp->gc_endtime = lunp->next_lun_avail_time; // 시간 갱신
+        }
+    }
+
+    if (cur->next_step < total)
+        return false;
+
+    /* update line status */
+    mark_line_free(conv_ftl, &ppa, cur->lm); // 라인을 프리 리스트로 복귀
+    cur->victim = NULL;
+
+    if (mg) {
+        NVMEV_DEBUG("%s: migrated SLC line %d: retained=%u migrated=%u\n", __func__,
+                ppa.g.blk, conv_ftl->mg_victim_retained, conv_ftl->mg_victim_migrated);
+        conv_ftl->mg_count++;
+        conv_ftl->mg_retained_pgs += conv_ftl->mg_victim_retained;
+        conv_ftl->mg_migrated_pgs += conv_ftl->mg_victim_migrated;
+        // SLC에 다시 쓴 만큼은 회수된 공간이 아님 (증분 모드는 gc_write_page()에서 이미 뺐다)
+        if (!incr_gc)
+            conv_ftl->slc_wfc.credits_to_refill = spp->slc_pgs_per_line - conv_ftl->mg_victim_retained;
+    }
+    return true;
+}
+
+/*
+ * 마이그레이션 희생 라인(SLC)을 골라 커서에 건다. 정리는 gc_run_steps()가 수행.
+ * GC와 달리 SLC는 유효 데이터도 TLC로 내보내야 하므로, 무효 페이지가 있는 라인이
+ * 없으면 가장 오래된 full 라인을 고른다.
+ */
+static int mg_begin(struct conv_ftl *conv_ftl, struct gc_cursor *cur)
+{
+    struct line_mgmt *lm = &conv_ftl->slc_lm;
+    struct line *victim_line = NULL;
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+
+    victim_line = lm->select_victim(conv_ftl, lm, true);
+    if (!victim_line && !list_empty(&lm->full_line_list)) {
+        victim_line = list_first_entry(&lm->full_line_list, struct line, entry);
+        list_del_init(&victim_line->entry);
+        lm->full_line_cnt--;
+    }
     if (!victim_line) {
         return -1; // 선택 실패 시 리턴
     }
 
-    ppa.g.blk = victim_line->id; // 선택된 라인 ID를 블록 주소로 설정
     // GC 정보 디버그 출력
-    NVMEV_DEBUG_VERBOSE("GC-ing line:%d,ipc=%d(%d),victim=%d,full=%d,free=%d\n", ppa.g.blk,
+    NVMEV_DEBUG_VERBOSE("GC-ing line:%d,ipc=%d(%d),victim=%d,full=%d,free=%d\n", victim_line->id,
             victim_line->ipc, victim_line->vpc, conv_ftl->slc_lm.victim_line_cnt,
             conv_ftl->slc_lm.full_line_cnt, conv_ftl->slc_lm.free_line_cnt);
 
     conv_ftl->slc_wfc.credits_to_refill = spp->slc_pgs_per_line; // 회수된 공간만큼 크레딧 리필량 설정
+    conv_ftl->mg_victim_retained = 0;
+    conv_ftl->mg_victim_migrated = 0;
 
-    /* copy back valid data */
-    // 모든 플래시 페이지를 순회하며 유효 데이터 이동
-    for (flashpg = 0; flashpg < spp->flashpgs_per_blk; flashpg++) {
-        int ch, lun;
+    cur->victim = victim_line;
+    cur->lm = &conv_ftl->slc_lm;
+    cur->next_step = 0;
+    return 0;
+}
 
-        ppa.g.pg = flashpg * spp->pgs_per_flashpg;
-        for (ch = 0; ch < spp->nchs; ch++) { // 모든 채널 순회
-            for (lun = 0; lun < spp->luns_per_ch; lun++) { // 모든 LUN 순회
-                struct nand_lun *lunp;
-
-                ppa.g.ch = ch;
-                ppa.g.lun = lun;
-                ppa.g.pl = 0;
-                lunp = get_lun(conv_ftl->ssd, &ppa);
-                clean_one_flashpg(conv_ftl, &ppa); // 해당 페이지 청소(복사)
-
-                if (flashpg == (spp->flashpgs_per_blk - 1)) { // 마지막 페이지라면 (블록 비우기 완료)
-                    struct convparams *cpp = &conv_ftl->cp;
-
-                    mark_block_free(conv_ftl, &ppa); // 블록 상태를 Free로 변경 (메타데이터)
-
-                    if (cpp->enable_gc_delay) { // Erase 지연 시뮬레이션
-                        struct nand_cmd gce = {
-                            .type = GC_IO,
-                            .cmd = NAND_ERASE, // 지우기 명령
-                            .stime = 0,
-                            .interleave_pci_dma = false,
-                            .ppa = &ppa,
-                        };
-                        ssd_advance_nand(conv_ftl->ssd, &gce);
-                    }
-
-                    lunp->gc_endtime = lunp->next_lun_avail_time; // 시간 갱신
-                }
-            }
-        }
-    }
+// 실제 마이그레이션을 수행하는 메인 함수 (라인 하나를 한 번에 정리)
+static int do_mg(struct conv_ftl *conv_ftl)
+{
+    struct gc_cursor cur;
 
-    /* update line status */
-    mark_line_free(conv_ftl, &ppa, &conv_ftl->slc_lm); // 라인을 프리 리스트로 복귀
+    if (mg_begin(conv_ftl, &cur) < 0)
+        return -1;
 
+    gc_run_steps(conv_ftl, &cur, UINT_MAX);
     return 0;
 }
-// 실제 GC를 수행하는 메인 함수
-static int do_gc(struct conv_ftl *conv_ftl, bool force)
+
+// GC 희생 라인(TLC)을 골라 커서에 건다. 정리는 gc_run_steps()가 수행
+static int gc_begin(struct conv_ftl *conv_ftl, struct gc_cursor *cur, bool force)
 {
     struct line *victim_line = NULL;
-    struct ssdparams *spp = &conv_ftl->ssd->sp;
-    struct ppa ppa;
-    int flashpg;
-    
-    victim_line = conv_ftl->tlc_lm.select_victim(conv_ftl, force);
+
+    victim_line = conv_ftl->tlc_lm.select_victim(conv_ftl, &conv_ftl->tlc_lm, force);
     if (!victim_line) {
         return -1; // 선택 실패 시 리턴
     }
     count_gc_victim_type(conv_ftl, victim_line);
-    
+
     conv_ftl->gc_count++;
-    ppa.g.blk = victim_line->id; // 선택된 라인 ID를 블록 주소로 설정
     // GC 정보 디버그 출력
-    NVMEV_DEBUG_VERBOSE("GC-ing line:%d,ipc=%d(%d),victim=%d,full=%d,free=%d\n", ppa.g.blk,
+    NVMEV_DEBUG_VERBOSE("GC-ing line:%d,ipc=%d(%d),victim=%d,full=%d,free=%d\n", victim_line->id,
             victim_line->ipc, victim_line->vpc, conv_ftl->tlc_lm.victim_line_cnt,
             conv_ftl->tlc_lm.full_line_cnt, conv_ftl->tlc_lm.free_line_cnt);
 
     conv_ftl->tlc_wfc.credits_to_refill = victim_line->ipc; // 회수된 공간만큼 크레딧 리필량 설정
 
-    /* copy back valid data */
-    // 모든 플래시 페이지를 순회하며 유효 데이터 이동
-    for (flashpg = 0; flashpg < spp->flashpgs_per_blk; flashpg++) {
-        int ch, lun;
+    cur->victim = victim_line;
+    cur->lm = &conv_ftl->tlc_lm;
+    cur->next_step = 0;
+    return 0;
+}
 
-        ppa.g.pg = flashpg * spp->pgs_per_flashpg;
-        for (ch = 0; ch < spp->nchs; ch++) { // 모든 채널 순회
-            for (lun = 0; lun < spp->luns_per_ch; lun++) { // 모든 LUN 순회
-                struct nand_lun *lunp;
-
-                ppa.g.ch = ch;
-                ppa.g.lun = lun;
-                ppa.g.pl = 0;
-                lunp = get_lun(conv_ftl->ssd, &ppa);
-                clean_one_flashpg(conv_ftl, &ppa); // 해당 페이지 청소(복사)
-
-                if (flashpg == (spp->flashpgs_per_blk - 1)) { // 마지막 페이지라면 (블록 비우기 완료)
-                    struct convparams *cpp = &conv_ftl->cp;
-
-                    mark_block_free(conv_ftl, &ppa); // 블록 상태를 Free로 변경 (메타데이터)
-
-                    if (cpp->enable_gc_delay) { // Erase 지연 시뮬레이션
-                        struct nand_cmd gce = {
-                            .type = GC_IO,
-                            .cmd = NAND_ERASE, // 지우기 명령
-                            .stime = 0,
-                            .interleave_pci_dma = false,
-                            .ppa = &ppa,
-                        };
-                        ssd_advance_nand(conv_ftl->ssd, &gce);
-                    }
-
-                    lunp->gc_endtime = lunp->next_lun_avail_time; // 시간 갱신
-                }
-            }
+// 실제 GC를 수행하는 메인 함수 (라인 하나를 한 번에 정리)
+static int do_gc(struct conv_ftl *conv_ftl, bool force)
+{
+    struct gc_cursor cur;
+
+    if (gc_begin(conv_ftl, &cur, force) < 0)
+        return -1;
+
+    gc_run_steps(conv_ftl, &cur, UINT_MAX);
+    return 0;
+}
+
+/*
+ * 증분 GC/마이그레이션 (incr_gc):
+ * 크레딧이 바닥나면 희생 라인을 커서에 걸고 회수될 페이지만큼 크레딧을 먼저 준다.
+ * 이후 쓰기마다 남은 스텝을 남은 크레딧으로 나눈 만큼만 진행해, 라인 하나의
+ * 복사 비용이 크레딧 구간 전체에 고르게 퍼지게 한다.
+ */
+static void incr_reclaim(struct conv_ftl *conv_ftl, struct write_flow_control *wfc, bool mg)
+{
+    struct gc_cursor *cur = mg ? &conv_ftl->mg_cur : &conv_ftl->gc_cur;
+    uint32_t remaining;
+
+    if (wfc->write_credits <= 0) {
+        if (cur->victim) { // 크레딧 안에 못 끝냄: 남은 스텝을 한 번에 마무리
+            conv_ftl->incr_gc_steps += gc_nr_steps(conv_ftl, cur->lm) - cur->next_step;
+            gc_run_steps(conv_ftl, cur, UINT_MAX);
+            conv_ftl->incr_gc_forced++;
         }
+
+        if (mg) {
+            if (should_mg_high(conv_ftl))
+                mg_begin(conv_ftl, cur);
+        } else if (should_gc_high(conv_ftl)) {
+            if (gc_begin(conv_ftl, cur, true) == 0)
+                conv_ftl->fg_gc_count++;
+        }
+        wfc->write_credits += wfc->credits_to_refill;
     }
 
-    /* update line status */
-    mark_line_free(conv_ftl, &ppa, &conv_ftl->tlc_lm); // 라인을 프리 리스트로 복귀
+    if (!cur->victim)
+        return;
 
-    return 0;
+    remaining = gc_nr_steps(conv_ftl, cur->lm) - cur->next_step;
+    remaining = DIV_ROUND_UP(remaining, max_t(uint32_t, wfc->write_credits, 1));
+    conv_ftl->incr_gc_steps += remaining;
+    gc_run_steps(conv_ftl, cur, remaining);
 }
 
 // 전경(Foreground) GC 수행 함수 (쓰기 도중 공간 부족 시 호출)
@@ -1374,7 +2244,138 @@ static void foreground_gc(struct conv_ftl *conv_ftl)
     if (should_gc_high(conv_ftl)) { // 긴급 임계값 체크
         NVMEV_DEBUG_VERBOSE("should_gc_high passed");
         /* perform GC here until !should_gc(conv_ftl) */
-        do_gc(conv_ftl, true); // 강제로 GC 수행
+        if (do_gc(conv_ftl, true) == 0) // 강제로 GC 수행
+            conv_ftl->fg_gc_count++;
+    }
+}
+
+/*
+ * 유휴 시간에 SLC 라인 하나를 TLC로 마이그레이션
+ * - SLC 프리 라인이 mg_thres_lines 이하인 동안(should_mg) 동작 -> 워터마크까지 비움
+ * - 스로틀링/유휴 판단은 백그라운드 GC와 같은 설정을 사용
+ */
+static void conv_bg_mg(struct conv_ftl *conv_ftl, uint64_t now)
+{
+    struct bg_gc_stat *bgs = &conv_ftl->bg_mg;
+    uint64_t copied;
+
+    if (!conv_ftl->slc_enabled || !should_mg(conv_ftl) || now < bgs->next_time)
+        return;
+
+    bgs->next_time = now + bg_gc_interval_us * 1000ULL;
+
+    if (ssd_next_idle_time(conv_ftl->ssd) > now + bg_gc_idle_slack_us * 1000ULL) {
+        bgs->nr_busy_skips++; // 아직 처리 중인 NAND 작업이 많음
+        return;
+    }
+
+    copied = conv_ftl->gc_copied_pages;
+    // 증분 마이그레이션이 진행 중인 라인이 있으면 그것부터 마저 정리
+    if (conv_ftl->mg_cur.victim) {
+        gc_run_steps(conv_ftl, &conv_ftl->mg_cur, UINT_MAX);
+    } else if (do_mg(conv_ftl) < 0) {
+        bgs->nr_no_victim++;
+        return;
+    }
+
+    bgs->nr_lines++;
+    bgs->nr_copied += conv_ftl->gc_copied_pages - copied;
+    NVMEV_DEBUG("%s: migrated a line, slc free=%d copied=%lld\n", __func__,
+            conv_ftl->slc_lm.free_line_cnt, conv_ftl->gc_copied_pages - copied);
+}
+
+// 유휴 시간에 희생 라인 하나를 정리하는 백그라운드 GC
+// - 프리 라인이 gc_thres_lines 이하이고(should_gc), LUN들이 거의 놀고 있을 때만 동작
+// - 한 번에 한 라인, bg_gc_interval_us 간격으로 스로틀링
+// - NAND 연산은 GC_IO로 ssd_advance_nand를 거치므로 이후 유저 IO와의 간섭이 모델링됨
+static void conv_bg_gc(struct conv_ftl *conv_ftl, uint64_t now)
+{
+    struct bg_gc_stat *bgs = &conv_ftl->bg_gc;
+    uint64_t copied;
+
+    if (!should_gc(conv_ftl) || now < bgs->next_time)
+        return;
+
+    bgs->next_time = now + bg_gc_interval_us * 1000ULL;
+
+    if (ssd_next_idle_time(conv_ftl->ssd) > now + bg_gc_idle_slack_us * 1000ULL) {
+        bgs->nr_busy_skips++; // 아직 처리 중인 NAND 작업이 많음
+        return;
+    }
+
+    copied = conv_ftl->gc_copied_pages;
+    // 증분 GC가 진행 중인 라인이 있으면 유휴 시간에 마저 정리.
+    // 없으면 force=false: Greedy는 유효 페이지가 많은 라인을 건너뜀 (긴급하지 않으므로)
+    if (conv_ftl->gc_cur.victim) {
+        gc_run_steps(conv_ftl, &conv_ftl->gc_cur, UINT_MAX);
+    } else if (do_gc(conv_ftl, false) < 0) {
+        bgs->nr_no_victim++;
+        return;
+    }
+
+    bgs->nr_lines++;
+    bgs->nr_copied += conv_ftl->gc_copied_pages - copied;
+    NVMEV_DEBUG("%s: reclaimed a line, free=%d copied=%lld\n", __func__,
+            conv_ftl->tlc_lm.free_line_cnt, conv_ftl->gc_copied_pages - copied);
+}
+
+/*
+ * TLC에 여유가 있으면 프리 TLC 라인을 바로 SLC로 돌린다.
+ * 지워지는 TLC 라인만 보고 확장하면, 프리 TLC 라인이 GC 임계값 근처에 머무는 한 확장이 일어나지 않는다.
+ * 빠진 프리 라인은 백그라운드 GC가 채우며, 트림 직후라면 희생 라인이 대부분 비어 있어 복사가 거의 없다.
+ */
+static void slc_try_grow(struct conv_ftl *conv_ftl)
+{
+    struct line_mgmt *slc_lm = &conv_ftl->slc_lm;
+    struct line_mgmt *tlc_lm = &conv_ftl->tlc_lm;
+    bool grown = false;
+
+    while (!list_empty(&tlc_lm->free_line_list) && want_slc_line(conv_ftl, false)) {
+        struct line *line = list_first_entry(&tlc_lm->free_line_list, struct line, entry);
+
+        list_del_init(&line->entry);
+        tlc_lm->free_line_cnt--;
+        tlc_lm->tt_lines--;
+
+        line->slc = true;
+        set_line_cell_mode(conv_ftl, line);
+        list_add_tail(&line->entry, &slc_lm->free_line_list);
+        slc_lm->free_line_cnt++;
+        slc_lm->tt_lines++;
+
+        conv_ftl->slc_grown++;
+        grown = true;
+    }
+
+    if (grown) {
+        update_mg_watermark(conv_ftl);
+        NVMEV_DEBUG("%s: slc=%u tlc=%u (free %u, slack %u)\n", __func__, slc_lm->tt_lines,
+                    tlc_lm->tt_lines, tlc_lm->free_line_cnt, tlc_slack_lines(conv_ftl));
+    }
+}
+
+// 디스패처 유휴 시 호출: 각 파티션에 SLC 확장, 백그라운드 GC/마이그레이션 기회를 줌
+void conv_proc_idle(struct nvmev_ns *ns)
+{
+    struct conv_ftl *conv_ftls = (struct conv_ftl *)ns->ftls;
+    uint64_t now = local_clock();
+    uint32_t i;
+
+    // 작업이 남아 있거나 다른 디스패처가 실행 중인 파티션은 건너뛴다
+    for (i = 0; i < ns->nr_parts; i++) {
+        struct conv_ftl *conv_ftl = &conv_ftls[i];
+
+        if (!conv_part_idle(conv_ftl) || !mutex_trylock(&conv_ftl->lock))
+            continue;
+
+        if (slc_dyn && conv_ftl->slc_enabled)
+            slc_try_grow(conv_ftl);
+        if (bg_mg)
+            conv_bg_mg(conv_ftl, now);
+        if (bg_gc)
+            conv_bg_gc(conv_ftl, now);
+
+        mutex_unlock(&conv_ftl->lock);
     }
 }
 // 전경(Foreground) GC 수행 함수 (쓰기 도중 공간 부족 시 호출)
@@ -1382,7 +2383,7 @@ static void foreground_mg(struct conv_ftl *conv_ftl)
 {
     if (should_mg_high(conv_ftl)) { // 긴급 임계값 체크
         NVMEV_DEBUG_VERBOSE("should_mg high passed");
-        do_mg(conv_ftl, true); // 강제로 mg 수행
+        do_mg(conv_ftl); // mg 수행
     }
 }
 // 두 PPA가 동일한 플래시 페이지(물리적 위치)인지 확인하는 함수
@@ -1396,129 +2397,397 @@ static bool is_same_flash_page(struct conv_ftl *conv_ftl, struct ppa ppa1, struc
     return (ppa1.h.blk_in_ssd == ppa2.h.blk_in_ssd) && (ppa1_page == ppa2_page);
 }
 
-// NVMe 읽기 명령 처리 함수
-static bool conv_read(struct nvmev_ns *ns, struct nvmev_request *req, struct nvmev_result *ret)
+// 파티션 하나가 담당하는 LPN들의 읽기 (start_lpn부터 nr_parts 간격)
+static void conv_read_part(struct conv_ftl *conv_ftl, struct conv_part_job *job)
 {
-    struct conv_ftl *conv_ftls = (struct conv_ftl *)ns->ftls;
-    struct conv_ftl *conv_ftl = &conv_ftls[0];
-    /* spp are shared by all instances*/
     struct ssdparams *spp = &conv_ftl->ssd->sp;
-
-    struct nvme_command *cmd = req->cmd;
-    uint64_t lba = cmd->rw.slba; // 시작 LBA
-    uint64_t nr_lba = (cmd->rw.length + 1); // 읽을 섹터 수
-    uint64_t start_lpn = lba / spp->secs_per_pg; // 시작 LPN
-    uint64_t end_lpn = (lba + nr_lba - 1) / spp->secs_per_pg; // 끝 LPN
+    uint32_t nr_parts = job->nr_parts;
+    uint64_t nsecs_completed, nsecs_latest = job->nsecs_latest;
+    uint32_t xfer_size = 0;
     uint64_t lpn;
-    uint64_t nsecs_start = req->nsecs_start; // 시작 시간
-    uint64_t nsecs_completed, nsecs_latest = nsecs_start;
-    uint32_t xfer_size, i;
-    uint32_t nr_parts = ns->nr_parts; // 파티션 수
-
     struct ppa prev_ppa;
     struct nand_cmd srd = {
         .type = USER_IO,
         .cmd = NAND_READ,
-        .stime = nsecs_start,
+        .stime = job->stime,
         .interleave_pci_dma = true,
     };
 
-    NVMEV_ASSERT(conv_ftls);
-    NVMEV_DEBUG_VERBOSE("%s: start_lpn=%lld, len=%lld, end_lpn=%lld", __func__, start_lpn, nr_lba, end_lpn);
-    if ((end_lpn / nr_parts) >= spp->tt_pgs) { // 범위 초과 검사
-        NVMEV_ERROR("%s: lpn passed FTL range (start_lpn=%lld > tt_pgs=%ld)\n", __func__,
-                start_lpn, spp->tt_pgs);
-        return false;
+    prev_ppa = get_maptbl_ent(conv_ftl, job->start_lpn / nr_parts); // 첫 PPA 조회
+
+    /* normal IO read path */
+    for (lpn = job->start_lpn; lpn <= job->end_lpn; lpn += nr_parts) { // LPN 순회
+        uint64_t local_lpn;
+        struct ppa cur_ppa;
+
+        local_lpn = lpn / nr_parts;
+        cur_ppa = get_maptbl_ent(conv_ftl, local_lpn); // 매핑 테이블 조회
+        if (!mapped_ppa(&cur_ppa) || !valid_ppa(conv_ftl, &cur_ppa)) { // 매핑 안됨 or 무효
+            NVMEV_DEBUG_VERBOSE("lpn 0x%llx not mapped to valid ppa\n", local_lpn);
+            NVMEV_DEBUG_VERBOSE("Invalid ppa,ch:%d,lun:%d,blk:%d,pl:%d,pg:%d\n",
+                    cur_ppa.g.ch, cur_ppa.g.lun, cur_ppa.g.blk,
+                    cur_ppa.g.pl, cur_ppa.g.pg);
+            continue;
+        }
+
+        // aggregate read io in same flash page
+        // 같은 플래시 페이지 내의 읽기 요청이면 묶어서 처리 (최적화)
+        if (mapped_ppa(&prev_ppa) &&
+            is_same_flash_page(conv_ftl, cur_ppa, prev_ppa)) {
+            xfer_size += spp->pgsz; // 전송 크기만 증가
+            continue;
+        }
+
+        if (xfer_size > 0) { // 이전까지 묶인 요청 처리
+            srd.xfer_size = xfer_size;
+            srd.ppa = &prev_ppa;
+            nsecs_completed = ssd_advance_nand(conv_ftl->ssd, &srd); // NAND 읽기 시뮬레이션
+            nsecs_latest = max(nsecs_completed, nsecs_latest); // 시간 갱신
+        }
+
+        xfer_size = spp->pgsz;
+        prev_ppa = cur_ppa;
     }
 
-    if (LBA_TO_BYTE(nr_lba) <= (KB(4) * nr_parts)) { // 4KB 이하면 짧은 지연시간 적용
-        srd.stime += spp->fw_4kb_rd_lat;
-    } else {
-        srd.stime += spp->fw_rd_lat;
-    }
-
-    for (i = 0; (i < nr_parts) && (start_lpn <= end_lpn); i++, start_lpn++) { // 파티션 별 처리
-        conv_ftl = &conv_ftls[start_lpn % nr_parts];
-        xfer_size = 0;
-        prev_ppa = get_maptbl_ent(conv_ftl, start_lpn / nr_parts); // 첫 PPA 조회
-
-        /* normal IO read path */
-        for (lpn = start_lpn; lpn <= end_lpn; lpn += nr_parts) { // LPN 순회
-            uint64_t local_lpn;
-            struct ppa cur_ppa;
-
-            local_lpn = lpn / nr_parts;
-            cur_ppa = get_maptbl_ent(conv_ftl, local_lpn); // 매핑 테이블 조회
-            if (!mapped_ppa(&cur_ppa) || !valid_ppa(conv_ftl, &cur_ppa)) { // 매핑 안됨 or 무효
-                NVMEV_DEBUG_VERBOSE("lpn 0x%llx not mapped to valid ppa\n", local_lpn);
-                NVMEV_DEBUG_VERBOSE("Invalid ppa,ch:%d,lun:%d,blk:%d,pl:%d,pg:%d\n",
-                        cur_ppa.g.ch, cur_ppa.g.lun, cur_ppa.g.blk,
-                        cur_ppa.g.pl, cur_ppa.g.pg);
-                continue;
-            }
+    // issue remaining io
+    // 남은 요청 처리
+    if (xfer_size > 0) {
+        srd.xfer_size = xfer_size;
+        srd.ppa = &prev_ppa;
+        nsecs_completed = ssd_advance_nand(conv_ftl->ssd, &srd);
+        nsecs_latest = max(nsecs_completed, nsecs_latest);
+    }
+
+    job->nsecs_latest = nsecs_latest;
+}
+
+// 쓰기 버퍼 반납 예약을 작업에 모아 둔다. 가득 차면 마지막 항목에 합쳐서 늦게 반납
+static void conv_defer_internal_operation(struct conv_part_job *job, uint64_t nsecs_target,
+                                          size_t size)
+{
+    struct conv_deferred_iop *iop;
+
+    if (job->nr_deferred_iops == CONV_MAX_DEFERRED_IOPS) {
+        iop = &job->deferred_iops[CONV_MAX_DEFERRED_IOPS - 1];
+        iop->nsecs_target = max(iop->nsecs_target, nsecs_target);
+        iop->size += size;
+        return;
+    }
+
+    iop = &job->deferred_iops[job->nr_deferred_iops++];
+    iop->nsecs_target = nsecs_target;
+    iop->size = size;
+}
+
+static void conv_write_part(struct conv_ftl *conv_ftl, struct conv_part_job *job);
+
+static void conv_run_part_job(struct conv_ftl *conv_ftl, struct conv_part_job *job)
+{
+    if (job->type == CONV_JOB_READ)
+        conv_read_part(conv_ftl, job);
+    else
+        conv_write_part(conv_ftl, job);
+}
+
+static inline bool conv_jq_has_job(struct conv_job_queue *jq)
+{
+    return jq->done != smp_load_acquire(&jq->tail);
+}
+
+static bool conv_part_has_job(struct conv_ftl *conv_ftl)
+{
+    uint32_t i;
+
+    for (i = 0; i < conv_ftl->nr_jqs; i++) {
+        if (conv_jq_has_job(&conv_ftl->jqs[i]))
+            return true;
+    }
+    return false;
+}
 
-            // aggregate read io in same flash page
-            // 같은 플래시 페이지 내의 읽기 요청이면 묶어서 처리 (최적화)
-            if (mapped_ppa(&prev_ppa) &&
-                is_same_flash_page(conv_ftl, cur_ppa, prev_ppa)) {
-                xfer_size += spp->pgsz; // 전송 크기만 증가
+/*
+ * 파티션 전용 스레드: 디스패처별 작업 큐를 돌아가며 하나씩 실행하고 done을 올려 완료를 알린다.
+ * 모든 큐가 CONV_PART_SPIN_NS 동안 비어 있으면 디스패처가 깨울 때까지 잠든다.
+ */
+static int conv_part_worker(void *data)
+{
+    struct conv_ftl *conv_ftl = data;
+    uint64_t last_job_time = local_clock();
+
+    while (!kthread_should_stop()) {
+        bool ran = false;
+        uint32_t i;
+
+        for (i = 0; i < conv_ftl->nr_jqs; i++) {
+            struct conv_job_queue *jq = &conv_ftl->jqs[i];
+            unsigned int done = jq->done;
+
+            if (!conv_jq_has_job(jq))
                 continue;
-            }
 
-            if (xfer_size > 0) { // 이전까지 묶인 요청 처리
-                srd.xfer_size = xfer_size;
-                srd.ppa = &prev_ppa;
-                nsecs_completed = ssd_advance_nand(conv_ftl->ssd, &srd); // NAND 읽기 시뮬레이션
-                nsecs_latest = max(nsecs_completed, nsecs_latest); // 시간 갱신
-            }
+            mutex_lock(&conv_ftl->lock);
+            conv_run_part_job(conv_ftl, &jq->jobs[done & (CONV_PART_QUEUE_DEPTH - 1)]);
+            mutex_unlock(&conv_ftl->lock);
+            smp_store_release(&jq->done, done + 1);
+            ran = true;
+        }
 
-            xfer_size = spp->pgsz;
-            prev_ppa = cur_ppa;
+        if (ran) {
+            last_job_time = local_clock();
+            continue;
         }
 
-        // issue remaining io
-        // 남은 요청 처리
-        if (xfer_size > 0) {
-            srd.xfer_size = xfer_size;
-            srd.ppa = &prev_ppa;
-            nsecs_completed = ssd_advance_nand(conv_ftl->ssd, &srd);
-            nsecs_latest = max(nsecs_completed, nsecs_latest);
+        if (local_clock() - last_job_time < CONV_PART_SPIN_NS) {
+            cond_resched();
+            continue;
         }
+
+        wait_event_interruptible(conv_ftl->job_wq,
+                                 conv_part_has_job(conv_ftl) || kthread_should_stop());
+        last_job_time = local_clock();
     }
 
-    ret->nsecs_target = nsecs_latest; // 완료 시간 설정
-    ret->status = NVME_SC_SUCCESS; // 성공 상태 설정
-    return true;
+    return 0;
 }
 
-// NVMe 쓰기 명령 처리 함수
-static bool conv_write(struct nvmev_ns *ns, struct nvmev_request *req, struct nvmev_result *ret)
+// 끝난 작업의 쓰기 버퍼 반납을 IO 워커에 등록 (작업의 SQ를 담당하는 디스패처에서만 호출)
+static void conv_schedule_deferred_iops(struct conv_ftl *conv_ftl, struct conv_part_job *job)
+{
+    uint32_t i;
+
+    for (i = 0; i < job->nr_deferred_iops; i++)
+        schedule_internal_operation(job->sq_id, job->deferred_iops[i].nsecs_target,
+                                    conv_ftl->ssd->write_buffer, job->deferred_iops[i].size);
+    job->nr_deferred_iops = 0;
+}
+
+// 명령의 마지막 작업이 회수됨: 결과를 IO 워커에 넘기고 컨텍스트를 반납
+static void conv_complete_cmd(struct conv_cmd_pool *pool, struct conv_cmd *cmd)
+{
+    struct nvmev_result ret = {
+        .status = NVME_SC_SUCCESS,
+        .nsecs_target = cmd->nsecs_latest,
+    };
+
+    nvmev_complete_deferred(&cmd->req, &ret);
+    cmd->next = pool->free_cmds;
+    pool->free_cmds = cmd;
+}
+
+// 파티션 스레드가 끝낸 작업을 회수 (@jq에 작업을 넣은 디스패처에서만 호출)
+static void conv_reap_part(struct conv_cmd_pool *pool, struct conv_ftl *conv_ftl,
+                           struct conv_job_queue *jq)
+{
+    unsigned int done = smp_load_acquire(&jq->done);
+
+    while (jq->reaped != done) {
+        struct conv_part_job *job = &jq->jobs[jq->reaped & (CONV_PART_QUEUE_DEPTH - 1)];
+        struct conv_cmd *cmd = job->cmd;
+
+        conv_schedule_deferred_iops(conv_ftl, job);
+        if (cmd) {
+            cmd->nsecs_latest = max(cmd->nsecs_latest, job->nsecs_latest);
+            if (--cmd->nr_jobs == 0)
+                conv_complete_cmd(pool, cmd);
+        }
+        jq->reaped++;
+    }
+}
+
+/*
+ * 디스패처 @id가 결과를 미룬 명령 마무리 (ns->proc_pending).
+ * 이 디스패처가 넣은 작업이 남아 있으면 true
+ */
+static bool conv_proc_pending(struct nvmev_ns *ns, unsigned int id)
 {
-    // ns->ftls 는 여러 파티션/인스턴스(conv_ftl[])를 가질 수 있음
     struct conv_ftl *conv_ftls = (struct conv_ftl *)ns->ftls;
-    struct conv_ftl *conv_ftl = &conv_ftls[0];
+    bool busy = false;
+    uint32_t i;
 
-    /* wbuf and spp are shared by all instances */
-    // ssdparams(spp): NAND geometry/타이밍 파라미터(페이지 크기 등)
+    for (i = 0; i < ns->nr_parts; i++) {
+        struct conv_ftl *conv_ftl = &conv_ftls[i];
+        struct conv_job_queue *jq;
+
+        if (!conv_ftl->part_worker)
+            continue;
+        jq = &conv_ftl->jqs[id];
+        conv_reap_part(&conv_ftls[0].pools[id], conv_ftl, jq);
+        busy |= jq->reaped != jq->tail;
+    }
+
+    return busy;
+}
+
+/*
+ * 지금까지 모든 디스패처가 파티션 스레드에 넣은 작업이 실행될 때까지 기다린다.
+ * FTL 상태를 디스패처에서 직접 건드리는 명령(트림, 플러시) 전에 호출한다.
+ * 다른 디스패처가 넣은 작업은 실행만 기다리고 회수는 그 디스패처에 맡긴다.
+ */
+static void conv_drain_parts(struct nvmev_ns *ns, unsigned int id)
+{
+    struct conv_ftl *conv_ftls = (struct conv_ftl *)ns->ftls;
+    uint32_t i, j;
+
+    for (i = 0; i < ns->nr_parts; i++) {
+        struct conv_ftl *conv_ftl = &conv_ftls[i];
+
+        if (!conv_ftl->part_worker)
+            continue;
+
+        for (j = 0; j < conv_ftl->nr_jqs; j++) {
+            struct conv_job_queue *jq = &conv_ftl->jqs[j];
+            unsigned int tail = smp_load_acquire(&jq->tail);
+
+            // 그 사이 다른 디스패처가 더 넣어 done이 tail을 지나갈 수 있다
+            while ((int)(tail - smp_load_acquire(&jq->done)) > 0)
+                cpu_relax();
+        }
+    }
+
+    conv_proc_pending(ns, id);
+}
+
+/*
+ * 요청을 파티션별 작업으로 나눠 실행한다.
+ * - 전용 스레드가 있는 파티션은 이 디스패처(@req->disp_id)의 작업 큐에 넣고 기다리지 않는다.
+ *   큐는 명령을 넘나들며 쌓이므로 작은 랜덤 IO도 파티션 스레드들에서 겹쳐 실행된다.
+ * - 스레드가 없는 파티션은 파티션 잠금을 잡고 디스패처에서 바로 실행한다.
+ * @wait가 false이면 (조기 완료 쓰기) 결과를 기다릴 필요가 없어 명령 컨텍스트를 잡지 않는다.
+ * 큐에 넣은 작업이 남아 있으면 명령 컨텍스트를, 모두 끝났으면 NULL을 반환하고
+ * 후자의 경우 *@nsecs_latest에 최종 완료 시각을 담는다.
+ */
+static struct conv_cmd *conv_run_parts(struct nvmev_ns *ns, struct conv_part_job *tmpl,
+                                       uint64_t start_lpn, struct nvmev_request *req,
+                                       bool wait, uint64_t *nsecs_latest)
+{
+    struct conv_ftl *conv_ftls = (struct conv_ftl *)ns->ftls;
+    const unsigned int id = req->disp_id;
+    struct conv_cmd_pool *pool = conv_ftls[0].pools ? &conv_ftls[0].pools[id] : NULL;
+    uint32_t nr_parts = ns->nr_parts;
+    uint32_t nr_jobs = min_t(uint64_t, nr_parts, tmpl->end_lpn - start_lpn + 1);
+    struct conv_cmd *cmd = NULL;
+    uint32_t i;
+
+    tmpl->sq_id = req->sq_id;
+    tmpl->nr_deferred_iops = 0;
+    *nsecs_latest = tmpl->nsecs_latest;
+
+    for (i = 0; i < nr_jobs; i++) {
+        struct conv_ftl *conv_ftl = &conv_ftls[(start_lpn + i) % nr_parts];
+        struct conv_job_queue *jq;
+        struct conv_part_job *job;
+
+        if (!conv_ftl->part_worker) {
+            struct conv_part_job inline_job = *tmpl;
+
+            inline_job.start_lpn = start_lpn + i;
+            inline_job.cmd = NULL;
+            mutex_lock(&conv_ftl->lock);
+            conv_run_part_job(conv_ftl, &inline_job);
+            mutex_unlock(&conv_ftl->lock);
+            conv_schedule_deferred_iops(conv_ftl, &inline_job);
+            *nsecs_latest = max(*nsecs_latest, inline_job.nsecs_latest);
+            continue;
+        }
+
+        if (wait && !cmd) {
+            // 컨텍스트가 모자라면 끝난 명령을 회수해 가며 기다린다
+            while (!pool->free_cmds) {
+                conv_proc_pending(ns, id);
+                cpu_relax();
+            }
+            cmd = pool->free_cmds;
+            pool->free_cmds = cmd->next;
+            cmd->req = *req;
+            cmd->nsecs_latest = *nsecs_latest;
+            cmd->nr_jobs = 1; // 제출이 끝나기 전에 완료되지 않도록 잡아 둔다
+        }
+
+        jq = &conv_ftl->jqs[id];
+        while (jq->tail - jq->reaped == CONV_PART_QUEUE_DEPTH) {
+            conv_reap_part(pool, conv_ftl, jq);
+            cpu_relax();
+        }
+
+        job = &jq->jobs[jq->tail & (CONV_PART_QUEUE_DEPTH - 1)];
+        *job = *tmpl;
+        job->start_lpn = start_lpn + i;
+        job->cmd = cmd;
+        if (cmd)
+            cmd->nr_jobs++;
+        smp_store_release(&jq->tail, jq->tail + 1);
+        if (wq_has_sleeper(&conv_ftl->job_wq))
+            wake_up(&conv_ftl->job_wq);
+    }
+
+    if (!cmd)
+        return NULL;
+
+    cmd->nsecs_latest = max(cmd->nsecs_latest, *nsecs_latest);
+    if (--cmd->nr_jobs)
+        return cmd;
+
+    // 제출 도중에 모든 작업이 회수됨
+    *nsecs_latest = cmd->nsecs_latest;
+    cmd->next = pool->free_cmds;
+    pool->free_cmds = cmd;
+    return NULL;
+}
+
+// NVMe 읽기 명령 처리 함수
+static bool conv_read(struct nvmev_ns *ns, struct nvmev_request *req, struct nvmev_result *ret)
+{
+    struct conv_ftl *conv_ftls = (struct conv_ftl *)ns->ftls;
+    struct conv_ftl *conv_ftl = &conv_ftls[0];
+    /* spp are shared by all instances*/
     struct ssdparams *spp = &conv_ftl->ssd->sp;
-     // write_buffer(wbuf): 호스트 write가 먼저 도착하는 DRAM 버퍼(시뮬레이션)
-    struct buffer *wbuf = conv_ftl->ssd->write_buffer; // 쓰기 버퍼
-    // 요청에서 NVMe RW 커맨드 읽기
+
     struct nvme_command *cmd = req->cmd;
-    // 시작 LBA / 길이(0-base length라 +1) / 페이지 단위로 범위 계산
     uint64_t lba = cmd->rw.slba; // 시작 LBA
-    uint64_t nr_lba = (cmd->rw.length + 1); // 길이
-    // LPN(Logical Page Number): LBA를 페이지 크기(섹터/페이지)로 나눈 논리 페이지 인덱스
-    uint64_t start_lpn = lba / spp->secs_per_pg;
-    uint64_t end_lpn = (lba + nr_lba - 1) / spp->secs_per_pg;
+    uint64_t nr_lba = (cmd->rw.length + 1); // 읽을 섹터 수
+    uint64_t start_lpn = lba / spp->secs_per_pg; // 시작 LPN
+    uint64_t end_lpn = (lba + nr_lba - 1) / spp->secs_per_pg; // 끝 LPN
+    uint64_t nsecs_start = req->nsecs_start; // 시작 시간
+    uint64_t nsecs_latest;
+    uint32_t nr_parts = ns->nr_parts; // 파티션 수
+    struct conv_part_job job;
 
-    uint64_t lpn;
-    uint32_t nr_parts = ns->nr_parts; // 파티션 수(스트라이핑/병렬화)
+    NVMEV_ASSERT(conv_ftls);
+    NVMEV_DEBUG_VERBOSE("%s: start_lpn=%lld, len=%lld, end_lpn=%lld", __func__, start_lpn, nr_lba, end_lpn);
+    if ((end_lpn / nr_parts) >= spp->tt_pgs) { // 범위 초과 검사
+        NVMEV_ERROR("%s: lpn passed FTL range (start_lpn=%lld > tt_pgs=%ld)\n", __func__,
+                start_lpn, spp->tt_pgs);
+        return false;
+    }
 
-    // 타이밍 시뮬레이션 변수
-    uint64_t nsecs_latest;          // 지금까지의 최종 완료 시간(최댓값)
-    uint64_t nsecs_xfer_completed;  // 호스트->버퍼 전송이 끝난 시각(early completion 기준)
-    uint32_t allocated_buf_size;    // wbuf에서 실제 확보한 크기
+    job.stime = nsecs_start;
+    if (LBA_TO_BYTE(nr_lba) <= (KB(4) * nr_parts)) { // 4KB 이하면 짧은 지연시간 적용
+        job.stime += spp->fw_4kb_rd_lat;
+    } else {
+        job.stime += spp->fw_rd_lat;
+    }
+
+    // 파티션별로 나눠 실행 (파티션 스레드가 있으면 큐에 넣고 완료는 나중에)
+    job.type = CONV_JOB_READ;
+    job.bypass_slc = false;
+    job.nr_parts = nr_parts;
+    job.end_lpn = end_lpn;
+    job.nsecs_latest = nsecs_start;
+    if (conv_run_parts(ns, &job, start_lpn, req, true, &nsecs_latest))
+        ret->deferred = true; // conv_proc_pending()이 완료를 넘김
+
+    ret->nsecs_target = nsecs_latest; // 완료 시간 설정
+    ret->status = NVME_SC_SUCCESS; // 성공 상태 설정
+    return true;
+}
+
+// 파티션 하나가 담당하는 LPN들의 쓰기 (start_lpn부터 nr_parts 간격)
+static void conv_write_part(struct conv_ftl *conv_ftl, struct conv_part_job *job)
+{
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+    uint32_t nr_parts = job->nr_parts;
+    uint64_t nsecs_latest = job->nsecs_latest;
+    uint64_t lpn;
 
     // NAND에 실제 program을 날릴 때 사용하는 내부 명령 구조체
     // - 여기서는 USER_IO + NAND_WRITE로 설정
@@ -1527,6 +2796,7 @@ static bool conv_write(struct nvmev_ns *ns, struct nvmev_request *req, struct nv
     struct nand_cmd swr = {
         .type = USER_IO,
         .cmd = NAND_WRITE,
+        .stime = job->stime,
         .interleave_pci_dma = false,
 
         // oneshotpg(=wordline 단위)로 모아서 한 번에 program하는 모델일 수 있음
@@ -1534,39 +2804,17 @@ static bool conv_write(struct nvmev_ns *ns, struct nvmev_request *req, struct nv
         .xfer_size = spp->pgsz * spp->pgs_per_oneshotpg,
     };
 
-    NVMEV_DEBUG_VERBOSE("%s: start_lpn=%lld, len=%lld, end_lpn=%lld", __func__, start_lpn, nr_lba, end_lpn);
-    // 범위 초과 검사: (end_lpn / nr_parts) 가 전체 페이지 범위를 넘는지 확인
-    if ((end_lpn / nr_parts) >= spp->tt_pgs) {
-        NVMEV_ERROR("%s: lpn passed FTL range (start_lpn=%lld > tt_pgs=%ld)\n",
-                    __func__, start_lpn, spp->tt_pgs);
-        return false;
-    }
-
-    // (1) 호스트 write 데이터를 write_buffer에 적재(할당) - 이 단계가 early completion의 기준이 되기도 함
-    allocated_buf_size = buffer_allocate(wbuf, LBA_TO_BYTE(nr_lba));
-    if (allocated_buf_size < LBA_TO_BYTE(nr_lba))
-        return false;
-
-    // (2) write_buffer로의 전송/버퍼링 시간 시뮬레이션
-    // nsecs_latest: 버퍼에 데이터가 들어오는 데 걸리는 시간이 반영됨
-    nsecs_latest = ssd_advance_write_buffer(conv_ftl->ssd,
-                                            req->nsecs_start,
-                                            LBA_TO_BYTE(nr_lba));
-    nsecs_xfer_completed = nsecs_latest;
-
-    // NAND program 명령의 시작 시각 설정
-    swr.stime = nsecs_latest;
-
     // (3) 실제 FTL 업데이트: LPN 단위로 순회
     // - LPN별로 "기존 페이지 invalidate → 새 PPA 할당 → map/rmap 갱신 → WP 전진"
-    for (lpn = start_lpn; lpn <= end_lpn; lpn++) {
+    for (lpn = job->start_lpn; lpn <= job->end_lpn; lpn += nr_parts) {
         uint64_t local_lpn;
         uint64_t nsecs_completed = 0;
         struct ppa ppa;
+        struct write_pointer *wp;
+        uint32_t stream;
 
-        // 파티셔닝: lpn % nr_parts 로 어느 ftl 인스턴스를 쓸지 결정
+        // 파티셔닝: 이 파티션은 lpn % nr_parts 가 같은 LPN만 담당
         // (stripe 분산). local_lpn은 해당 파티션 내부 LPN
-        conv_ftl = &conv_ftls[lpn % nr_parts];
         local_lpn = lpn / nr_parts;
 
         // (3-1) 기존 매핑 확인
@@ -1584,12 +2832,19 @@ static bool conv_write(struct nvmev_ns *ns, struct nvmev_request *req, struct nv
         }
         /* new write */
         // (3-2) 새 물리 페이지 할당
-        // ★ 여기서 USER_IO를 넘기는 게 핵심:
-        //   - get_new_page 내부에서 __get_wp(USER_IO)로 USER용 WP(SLC/TLC) 선택
-        //   - 라인 소진 시 prepare_write_pointer(USER_IO) 호출
-        //   - 너의 정책: SLC 버퍼면 USER는 SLC(또는 상황에 따라 TLC), GC는 TLC 강제
-        //   → 이 정책이 깨지지 않도록 get_new_page/advance_wp 쪽을 수정해야 함
-        ppa = get_new_page(conv_ftl, USER_IO);
+        // ★ 온도 분류기로 스트림을 정하고 그 스트림의 유저 WP를 사용:
+        //   - SLC 버퍼면 USER는 SLC WP 하나, 아니면 스트림별 TLC WP
+        //   - GC는 세대별 gc_wp(TLC)로만 내려가므로 유저/GC 라인이 섞이지 않음
+        //   - 순차 스트림으로 판정된 명령은 SLC를 건너뛰고 스트림별 TLC WP로 바로 기록
+        stream = classify_user_write(conv_ftl, local_lpn);
+        if (job->bypass_slc && conv_ftl->slc_enabled) {
+            wp = &conv_ftl->tlc_wp[stream];
+            conv_ftl->seq_bypass_pgs++;
+        } else {
+            wp = __get_user_wp(conv_ftl, stream);
+        }
+        ppa = get_new_page(conv_ftl, wp);
+        conv_ftl->stream_user_pgs[stream]++;
 
         /* update maptbl */
         // (3-3) 매핑테이블 업데이트: local_lpn -> 새 ppa
@@ -1605,29 +2860,29 @@ static bool conv_write(struct nvmev_ns *ns, struct nvmev_request *req, struct nv
 
         /* need to advance the write pointer here */
         // (3-6) write pointer 전진
-        // ★ 이것도 USER_IO를 넘기는 게 핵심:
+        // ★ 같은 WP를 전진시켜야 함:
         //   - 페이지/워드라인/블록/라인 경계를 넘어갈 때
-        //   - 라인이 꽉 차면 "현재 라인을 full로 전이 + 새 라인 할당(prepare_write_pointer)"
-        //   - 여기서 USER_IO/GC_IO를 구분 못하면 GC가 SLC 라인에 들어가거나 반대 문제가 발생
-        advance_write_pointer(conv_ftl, USER_IO);
+        //   - 라인이 꽉 차면 "현재 라인을 full로 전이 + wp->lm에서 새 라인 할당"
+        advance_write_pointer(conv_ftl, wp);
 
         /* Aggregate write io in flash page */
         // (4) oneshot(wordline) 단위로 모아서 NAND program을 발행하는 모델:
         // - last_pg_in_wordline()이 true일 때만 실제 NAND_WRITE를 시뮬레이션한다.
         // - 즉, 매 LPN마다 바로 NAND에 쓰는 게 아니라, 내부적으로 "모아서" 쓰는 구조.
-        if (last_pg_in_wordline(conv_ftl, &ppa,USER_IO)) {
-            // 이번 oneshot program을 대표하는 ppa를 swr에 넣는다
+        if (last_pg_in_wordline(conv_ftl, &ppa, wp)) {
+            // 이번 oneshot program을 대표하는 ppa를 swr에 넣는다 (SLC면 SLC 원샷 크기)
+            // 마이그레이션이 SLC에 남긴 페이지가 섞여 있으면 그 읽기가 끝난 뒤에 프로그램
             swr.ppa = &ppa;
+            swr.xfer_size = wp_program_size(conv_ftl, wp);
+            swr.stime = max(job->stime, wp->gather_stime);
+            wp->gather_stime = 0;
 
             // NAND program 시뮬레이션 수행
             nsecs_completed = ssd_advance_nand(conv_ftl->ssd, &swr);
             nsecs_latest = max(nsecs_completed, nsecs_latest);
 
             // 내부 연산(프로그램) 완료 시점에 buffer 소비/반납 등을 스케줄링
-            schedule_internal_operation(req->sq_id,
-                                        nsecs_completed,
-                                        wbuf,
-                                        spp->pgs_per_oneshotpg * spp->pgsz);
+            conv_defer_internal_operation(job, nsecs_completed, swr.xfer_size);
         }
         // (5) 크레딧 기반 제어
         // - write credit은 모델에서 write/GC 타이밍 또는 병목을 제어하는 장치일 가능성이 큼
@@ -1635,13 +2890,125 @@ static bool conv_write(struct nvmev_ns *ns, struct nvmev_request *req, struct nv
         // ★ 여기서 GC가 돌면:
         //   - GC 경로의 nand_cmd.type == GC_IO 가 되어야 하고
         //   - get_new_page/advance_wp 호출도 GC_IO로 내려가야 "GC는 TLC 라인 강제"가 보장됨
-        consume_write_credit(conv_ftl);
-        check_and_refill_write_credit(conv_ftl);
+        consume_write_credit(conv_ftl, wp);
+        check_and_refill_write_credit(conv_ftl, wp);
+    }
+
+    job->nsecs_latest = nsecs_latest;
+}
+
+/*
+ * 쓰기 명령 하나를 순차 스트림 감지기에 반영하고, 이 명령이 SLC를 우회할지 반환
+ * - 이전 명령의 끝에 바로 이어지는 스트림이 있으면 연속 길이를 늘리고,
+ *   없으면 가장 오래 안 쓰인 슬롯을 새 스트림으로 교체
+ * - 연속 길이(이번 명령 포함)가 seq_bypass_pages 이상이면 우회
+ */
+static bool seq_detect_write(struct seq_detect *sd, uint64_t start_lpn, uint64_t end_lpn)
+{
+    struct seq_stream *st = NULL, *lru = &sd->streams[0];
+    uint64_t nr_pgs = end_lpn - start_lpn + 1;
+    int i;
+
+    if (!seq_bypass_pages)
+        return false;
+
+    sd->nr_cmds++;
+    for (i = 0; i < SEQ_MAX_STREAMS; i++) {
+        struct seq_stream *cand = &sd->streams[i];
+
+        if (cand->run_pgs && cand->next_lpn == start_lpn) {
+            st = cand;
+            break;
+        }
+        if (cand->last_used < lru->last_used)
+            lru = cand;
+    }
+
+    if (st) {
+        st->run_pgs += nr_pgs;
+    } else {
+        st = lru;
+        st->run_pgs = nr_pgs;
     }
+    st->next_lpn = end_lpn + 1;
+    st->last_used = sd->nr_cmds;
+
+    return st->run_pgs >= seq_bypass_pages;
+}
+
+// NVMe 쓰기 명령 처리 함수
+static bool conv_write(struct nvmev_ns *ns, struct nvmev_request *req, struct nvmev_result *ret)
+{
+    // ns->ftls 는 여러 파티션/인스턴스(conv_ftl[])를 가질 수 있음
+    struct conv_ftl *conv_ftls = (struct conv_ftl *)ns->ftls;
+    struct conv_ftl *conv_ftl = &conv_ftls[0];
+
+    /* wbuf and spp are shared by all instances */
+    // ssdparams(spp): NAND geometry/타이밍 파라미터(페이지 크기 등)
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+     // write_buffer(wbuf): 호스트 write가 먼저 도착하는 DRAM 버퍼(시뮬레이션)
+    struct buffer *wbuf = conv_ftl->ssd->write_buffer; // 쓰기 버퍼
+    // 요청에서 NVMe RW 커맨드 읽기
+    struct nvme_command *cmd = req->cmd;
+    // 시작 LBA / 길이(0-base length라 +1) / 페이지 단위로 범위 계산
+    uint64_t lba = cmd->rw.slba; // 시작 LBA
+    uint64_t nr_lba = (cmd->rw.length + 1); // 길이
+    // LPN(Logical Page Number): LBA를 페이지 크기(섹터/페이지)로 나눈 논리 페이지 인덱스
+    uint64_t start_lpn = lba / spp->secs_per_pg;
+    uint64_t end_lpn = (lba + nr_lba - 1) / spp->secs_per_pg;
+
+    uint32_t nr_parts = ns->nr_parts; // 파티션 수(스트라이핑/병렬화)
+    // FUA 또는 early completion 비활성화면 NAND 작업까지 기다려야 함
+    bool wait = (cmd->rw.control & NVME_RW_FUA) || (spp->write_early_completion == 0);
+
+    // 타이밍 시뮬레이션 변수
+    uint64_t nsecs_latest;          // 지금까지의 최종 완료 시간(최댓값)
+    uint64_t nsecs_xfer_completed;  // 호스트->버퍼 전송이 끝난 시각(early completion 기준)
+    uint32_t allocated_buf_size;    // wbuf에서 실제 확보한 크기
+
+    // 파티션 스레드에 넘길 작업 (NAND program은 USER_IO + NAND_WRITE)
+    struct conv_part_job job;
+
+    NVMEV_DEBUG_VERBOSE("%s: start_lpn=%lld, len=%lld, end_lpn=%lld", __func__, start_lpn, nr_lba, end_lpn);
+    // 범위 초과 검사: (end_lpn / nr_parts) 가 전체 페이지 범위를 넘는지 확인
+    if ((end_lpn / nr_parts) >= spp->tt_pgs) {
+        NVMEV_ERROR("%s: lpn passed FTL range (start_lpn=%lld > tt_pgs=%ld)\n",
+                    __func__, start_lpn, spp->tt_pgs);
+        return false;
+    }
+
+    // (1) 호스트 write 데이터를 write_buffer에 적재(할당) - 이 단계가 early completion의 기준이 되기도 함
+    allocated_buf_size = buffer_allocate(wbuf, LBA_TO_BYTE(nr_lba));
+    if (allocated_buf_size < LBA_TO_BYTE(nr_lba))
+        return false;
+
+    // (2) write_buffer로의 전송/버퍼링 시간 시뮬레이션
+    // nsecs_latest: 버퍼에 데이터가 들어오는 데 걸리는 시간이 반영됨
+    nsecs_latest = ssd_advance_write_buffer(conv_ftl->ssd,
+                                            req->nsecs_start,
+                                            LBA_TO_BYTE(nr_lba));
+    nsecs_xfer_completed = nsecs_latest;
+
+    // (3) 실제 FTL 업데이트: 파티션별로 나눠 실행
+    // 쓰기 버퍼 반납은 각 파티션 작업이 끝난 뒤 등록된다 (conv_schedule_deferred_iops)
+    job.type = CONV_JOB_WRITE;
+    job.bypass_slc = false;
+    if (conv_ftl->slc_enabled) {
+        spin_lock(&conv_ftl->seq_lock);
+        job.bypass_slc = seq_detect_write(&conv_ftl->seq, start_lpn, end_lpn);
+        spin_unlock(&conv_ftl->seq_lock);
+    }
+    job.nr_parts = nr_parts;
+    job.end_lpn = end_lpn;
+    job.stime = nsecs_latest; // NAND program 명령의 시작 시각
+    job.nsecs_latest = nsecs_latest;
+    if (conv_run_parts(ns, &job, start_lpn, req, wait, &nsecs_latest))
+        ret->deferred = true; // conv_proc_pending()이 완료를 넘김
+
     // (6) NVMe completion 타이밍 결정
     // - FUA 또는 early completion 비활성화면: 실제 NAND 작업까지 기다림(nsecs_latest)
     // - 아니면: 버퍼 전송 완료 시점에 조기 완료(nsecs_xfer_completed)
-    if ((cmd->rw.control & NVME_RW_FUA) || (spp->write_early_completion == 0)) {
+    if (wait) {
         /* Wait all flash operations */
         ret->nsecs_target = nsecs_latest;
     } else {
@@ -1653,6 +3020,147 @@ static bool conv_write(struct nvmev_ns *ns, struct nvmev_request *req, struct nv
     return true;
 }
 
+// LPN 하나의 매핑 해제 (deallocate). 매핑이 없으면 false
+static bool conv_trim_lpn(struct conv_ftl *conv_ftl, uint64_t local_lpn)
+{
+    struct ppa ppa = get_maptbl_ent(conv_ftl, local_lpn);
+
+    if (!mapped_ppa(&ppa) || !valid_ppa(conv_ftl, &ppa))
+        return false;
+
+    // 물리 페이지 무효화 -> GC가 더 이상 복사하지 않음
+    mark_page_invalid(conv_ftl, &ppa);
+    set_rmap_ent(conv_ftl, INVALID_LPN, &ppa);
+
+    ppa.ppa = UNMAPPED_PPA;
+    set_maptbl_ent(conv_ftl, local_lpn, &ppa);
+
+    conv_ftl->trimmed_pgs++;
+    return true;
+}
+
+// LBA 범위가 네임스페이스와 매핑 테이블 안에 들어오는지 검사
+static bool conv_trim_range_valid(struct nvmev_ns *ns, uint64_t slba, uint64_t nr_lba)
+{
+    struct conv_ftl *conv_ftls = (struct conv_ftl *)ns->ftls;
+    struct ssdparams *spp = &conv_ftls[0].ssd->sp;
+    uint64_t end_lpn;
+
+    if (nr_lba == 0)
+        return true;
+
+    if (slba + nr_lba < slba || slba + nr_lba > BYTE_TO_LBA(ns->size)) {
+        NVMEV_ERROR("%s: range passed namespace (slba=%lld, nlb=%lld)\n",
+                    __func__, slba, nr_lba);
+        return false;
+    }
+
+    end_lpn = (slba + nr_lba) / spp->secs_per_pg; // exclusive
+    return end_lpn == 0 || (end_lpn - 1) / ns->nr_parts < spp->tt_pgs;
+}
+
+/*
+ * LBA 범위 매핑 해제. 페이지 전체가 범위에 포함된 경우만 해제하고,
+ * 일부만 걸친 앞뒤 페이지는 매핑을 유지한다.
+ * 중간에 멈추지 않도록 호출 전에 conv_trim_range_valid()로 전체 범위를 검사해야 한다.
+ */
+static void conv_trim_range(struct nvmev_ns *ns, uint64_t slba, uint64_t nr_lba)
+{
+    struct conv_ftl *conv_ftls = (struct conv_ftl *)ns->ftls;
+    struct ssdparams *spp = &conv_ftls[0].ssd->sp;
+    uint32_t nr_parts = ns->nr_parts;
+    uint64_t start_lpn, end_lpn, lpn;
+
+    uint32_t i;
+
+    start_lpn = DIV_ROUND_UP(slba, spp->secs_per_pg);
+    end_lpn = (slba + nr_lba) / spp->secs_per_pg; // exclusive
+
+    // 파티션마다 잠금을 한 번만 잡도록 파티션 단위로 순회
+    for (i = 0; i < nr_parts; i++) {
+        struct conv_ftl *conv_ftl = &conv_ftls[i];
+
+        // start_lpn 이상에서 이 파티션이 담당하는 첫 LPN
+        lpn = start_lpn + (i + nr_parts - start_lpn % nr_parts) % nr_parts;
+        if (lpn >= end_lpn)
+            continue;
+
+        mutex_lock(&conv_ftl->lock);
+        for (; lpn < end_lpn; lpn += nr_parts)
+            conv_trim_lpn(conv_ftl, lpn / nr_parts);
+        mutex_unlock(&conv_ftl->lock);
+    }
+}
+
+// NVMe Dataset Management 명령 처리 (Deallocate 속성만 지원)
+static void conv_dsm(struct nvmev_ns *ns, struct nvmev_request *req, struct nvmev_result *ret)
+{
+    struct conv_ftl *conv_ftl = &((struct conv_ftl *)ns->ftls)[0];
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+    struct nvme_dsm_cmd *dsm = &req->cmd->dsm;
+    struct nvme_dsm_range *ranges;
+    uint32_t nr = (dsm->nr & 0xff) + 1; // 0-based
+    size_t len = nr * sizeof(*ranges);
+    uint32_t i;
+
+    ret->status = NVME_SC_SUCCESS;
+    ret->nsecs_target = req->nsecs_start + spp->fw_4kb_rd_lat;
+
+    // 힌트(integral read/write)만 있는 경우 할 일이 없다
+    if (!(dsm->attributes & NVME_DSMGMT_AD))
+        return;
+
+    ranges = kmalloc(len, GFP_KERNEL);
+    if (!ranges) {
+        ret->status = NVME_SC_INTERNAL;
+        return;
+    }
+
+    if (nvmev_copy_from_prp(dsm->prp1, dsm->prp2, ranges, len) < len) {
+        ret->status = NVME_SC_DATA_XFER_ERROR;
+        goto out;
+    }
+
+    // 범위 하나라도 잘못되면 아무것도 해제하지 않는다
+    for (i = 0; i < nr; i++) {
+        if (!conv_trim_range_valid(ns, le64_to_cpu(ranges[i].slba), le32_to_cpu(ranges[i].nlb))) {
+            ret->status = NVME_SC_LBA_RANGE;
+            goto out;
+        }
+    }
+
+    conv_drain_parts(ns, req->disp_id); // 앞서 받은 쓰기가 매핑에 반영될 때까지 기다린다
+    for (i = 0; i < nr; i++)
+        conv_trim_range(ns, le64_to_cpu(ranges[i].slba), le32_to_cpu(ranges[i].nlb));
+
+out:
+    kfree(ranges);
+}
+
+// NVMe Write Zeroes 처리: NAND program 없이 범위를 매핑 해제한다
+static void conv_write_zeroes(struct nvmev_ns *ns, struct nvmev_request *req,
+                              struct nvmev_result *ret)
+{
+    struct conv_ftl *conv_ftl = &((struct conv_ftl *)ns->ftls)[0];
+    struct ssdparams *spp = &conv_ftl->ssd->sp;
+    struct nvme_command *cmd = req->cmd;
+
+    /*
+     * 백업 스토리지는 IO 워커가 0으로 채운다. 페이지 일부만 걸친 경우
+     * 매핑이 남아 있어도 읽으면 0이 나오므로 동작은 같다.
+     */
+    if (!conv_trim_range_valid(ns, cmd->rw.slba, (uint64_t)cmd->rw.length + 1)) {
+        ret->status = NVME_SC_LBA_RANGE;
+        ret->nsecs_target = req->nsecs_start;
+        return;
+    }
+    conv_drain_parts(ns, req->disp_id);
+    conv_trim_range(ns, cmd->rw.slba, (uint64_t)cmd->rw.length + 1);
+
+    ret->status = NVME_SC_SUCCESS;
+    ret->nsecs_target = req->nsecs_start + spp->fw_4kb_rd_lat;
+}
+
 // NVMe Flush 명령 처리 함수
 static void conv_flush(struct nvmev_ns *ns, struct nvmev_request *req, struct nvmev_result *ret)
 {
@@ -1660,19 +3168,66 @@ static void conv_flush(struct nvmev_ns *ns, struct nvmev_request *req, struct nv
     uint32_t i;
     struct conv_ftl *conv_ftls = (struct conv_ftl *)ns->ftls;
     
+    conv_drain_parts(ns, req->disp_id); // 큐에 쌓인 파티션 작업까지 반영
+
     start = local_clock(); // 현재 시간
     latest = start;
     for (i = 0; i < ns->nr_parts; i++) { // 모든 인스턴스 확인
+        mutex_lock(&conv_ftls[i].lock);
         latest = max(latest, ssd_next_idle_time(conv_ftls[i].ssd)); // SSD가 유휴 상태가 되는 시간 계산
+        mutex_unlock(&conv_ftls[i].lock);
     }
     
     NVMEV_DEBUG_VERBOSE("%s: latency=%llu\n", __func__, latest - start);
     uint64_t total_gc = 0;
     uint64_t total_copied = 0;
+    uint64_t total_fg_gc = 0;
+    struct bg_gc_stat bgs = { 0 };
+    uint64_t cb_checked = 0, cb_mismatch = 0;
+    uint64_t trimmed = 0;
+    uint64_t incr_steps = 0, incr_forced = 0;
+    uint64_t suspends = 0;
+    uint64_t erase_total = 0, nr_erases = 0, erase_ns = 0, nr_blks = 0;
+    uint64_t blk_erases;
+    uint32_t erase_max = 0, blk_max;
+    uint64_t nr_reads = 0, retried_reads = 0, read_retries = 0;
+    uint64_t reordered = 0, reorder_delay = 0;
+    uint64_t slc_grown = 0, slc_shrunk = 0, slc_lines = 0;
+    uint64_t mg_count = 0, mg_retained = 0, mg_migrated = 0;
+    uint64_t seq_bypass = 0;
     
     for (i = 0; i < ns->nr_parts; i++) {
         total_gc += conv_ftls[i].gc_count;
         total_copied += conv_ftls[i].gc_copied_pages;
+        total_fg_gc += conv_ftls[i].fg_gc_count;
+        bgs.nr_lines += conv_ftls[i].bg_gc.nr_lines;
+        bgs.nr_copied += conv_ftls[i].bg_gc.nr_copied;
+        bgs.nr_busy_skips += conv_ftls[i].bg_gc.nr_busy_skips;
+        bgs.nr_no_victim += conv_ftls[i].bg_gc.nr_no_victim;
+        cb_checked += conv_ftls[i].cb_validate_cnt;
+        cb_mismatch += conv_ftls[i].cb_validate_mismatch;
+        trimmed += conv_ftls[i].trimmed_pgs;
+        incr_steps += conv_ftls[i].incr_gc_steps;
+        incr_forced += conv_ftls[i].incr_gc_forced;
+        suspends += conv_ftls[i].ssd->nr_suspends;
+        ssd_get_erase_stats(conv_ftls[i].ssd, &blk_erases, &blk_max);
+        erase_total += blk_erases;
+        erase_max = max(erase_max, blk_max);
+        nr_blks += conv_ftls[i].ssd->sp.tt_blks;
+        nr_erases += conv_ftls[i].ssd->nr_erases;
+        erase_ns += conv_ftls[i].ssd->erase_ns;
+        nr_reads += conv_ftls[i].ssd->nr_reads;
+        retried_reads += conv_ftls[i].ssd->nr_retried_reads;
+        read_retries += conv_ftls[i].ssd->nr_read_retries;
+        reordered += conv_ftls[i].ssd->nr_reordered;
+        reorder_delay += conv_ftls[i].ssd->reorder_delay_ns;
+        slc_grown += conv_ftls[i].slc_grown;
+        slc_shrunk += conv_ftls[i].slc_shrunk;
+        slc_lines += conv_ftls[i].slc_lm.tt_lines;
+        mg_count += conv_ftls[i].mg_count;
+        mg_retained += conv_ftls[i].mg_retained_pgs;
+        mg_migrated += conv_ftls[i].mg_migrated_pgs;
+        seq_bypass += conv_ftls[i].seq_bypass_pgs;
     }
     
     printk(KERN_INFO "NVMeVirt: [FLUSH - Final GC Stats]\n");
@@ -1680,13 +3235,76 @@ static void conv_flush(struct nvmev_ns *ns, struct nvmev_request *req, struct nv
     printk(KERN_INFO "NVMeVirt:  Total Copied Pages: %llu\n", total_copied);
     printk(KERN_INFO "NVMeVirt:  Avg Pages per GC: %llu\n", 
             total_gc > 0 ? total_copied / total_gc : 0);
-    if (total_gc_cnt > 0) {
+    printk(KERN_INFO "NVMeVirt:  Foreground GC: %llu\n", total_fg_gc);
+    printk(KERN_INFO "NVMeVirt:  Background GC: %llu lines, %llu copied (skipped busy=%llu no_victim=%llu)\n",
+            bgs.nr_lines, bgs.nr_copied, bgs.nr_busy_skips, bgs.nr_no_victim);
+    memset(&bgs, 0, sizeof(bgs));
+    for (i = 0; i < ns->nr_parts; i++) {
+        bgs.nr_lines += conv_ftls[i].bg_mg.nr_lines;
+        bgs.nr_copied += conv_ftls[i].bg_mg.nr_copied;
+        bgs.nr_busy_skips += conv_ftls[i].bg_mg.nr_busy_skips;
+        bgs.nr_no_victim += conv_ftls[i].bg_mg.nr_no_victim;
+    }
+    printk(KERN_INFO "NVMeVirt:  Background MG: %llu lines, %llu copied (skipped busy=%llu no_victim=%llu)\n",
+            bgs.nr_lines, bgs.nr_copied, bgs.nr_busy_skips, bgs.nr_no_victim);
+    if (conv_ftls[0].slc_enabled) {
+        printk(KERN_INFO "NVMeVirt:  SLC Lines: %llu (grown=%llu shrunk=%llu)\n",
+                slc_lines, slc_grown, slc_shrunk);
+        printk(KERN_INFO "NVMeVirt:  Migration: %llu lines, retained in SLC %llu, migrated to TLC %llu (per line %llu/%llu)\n",
+                mg_count, mg_retained, mg_migrated,
+                mg_count ? mg_retained / mg_count : 0, mg_count ? mg_migrated / mg_count : 0);
+        printk(KERN_INFO "NVMeVirt:  Sequential SLC Bypass Pages: %llu\n", seq_bypass);
+    }
+    for (i = 0; i < conv_nr_streams(); i++) {
+        uint64_t user = 0, gc = 0, retained = 0;
+        uint32_t j;
+
+        for (j = 0; j < ns->nr_parts; j++) {
+            user += conv_ftls[j].stream_user_pgs[i];
+            gc += conv_ftls[j].stream_gc_pgs[i];
+            retained += conv_ftls[j].stream_retained_pgs[i];
+        }
+        // WAF = (유저 쓰기 + GC 복사) / 유저 쓰기, 소수점 둘째 자리까지 (SLC 유지분은 별도 표기)
+        printk(KERN_INFO "NVMeVirt:  Stream %u: user %llu, gc %llu, WAF %llu.%02llu, retained in SLC %llu\n",
+                i, user, gc, user ? (user + gc) / user : 0,
+                user ? ((user + gc) * 100 / user) % 100 : 0, retained);
+    }
+    for (i = 0; i < conv_nr_gc_gens(); i++) {
+        uint64_t copied = 0;
+        uint32_t j;
+
+        for (j = 0; j < ns->nr_parts; j++)
+            copied += conv_ftls[j].gc_gen_copied[i];
+        printk(KERN_INFO "NVMeVirt:  GC generation %u: %llu copies\n", i + 1, copied);
+    }
+    printk(KERN_INFO "NVMeVirt:  Deallocated Pages: %llu\n", trimmed);
+    printk(KERN_INFO "NVMeVirt:  GC program/erase suspends: %llu\n", suspends);
+    printk(KERN_INFO "NVMeVirt:  Block Erases: %llu (avg %llu, max %u per block), timed %llu, avg tBERS %llu ns\n",
+            erase_total, nr_blks ? erase_total / nr_blks : 0, erase_max,
+            nr_erases, nr_erases ? erase_ns / nr_erases : 0);
+    printk(KERN_INFO "NVMeVirt:  Read Retry: %llu of %llu reads retried, %llu retries (avg %llu per retried read)\n",
+            retried_reads, nr_reads, read_retries,
+            retried_reads ? read_retries / retried_reads : 0);
+    printk(KERN_INFO "NVMeVirt:  LUN Scheduler (%s): %llu ops reordered, %llu ns pushed onto bypassed GC/MIG ops\n",
+            ssd_lun_sched_name(conv_ftls[0].ssd), reordered, reorder_delay);
+    if (incr_gc)
+        printk(KERN_INFO "NVMeVirt:  Incremental GC: %llu steps, %llu forced finishes\n",
+                incr_steps, incr_forced);
+    if (cb_checked > 0)
+        printk(KERN_INFO "NVMeVirt:  CB index validation: %llu checked, %llu mismatched\n",
+                cb_checked, cb_mismatch);
+    if (atomic64_read(&total_gc_cnt) > 0) {
+        uint64_t sampled = atomic64_read(&total_gc_cnt);
+        uint64_t cold = atomic64_read(&cold_gc_cnt);
+        uint64_t chosen = atomic64_read(&victim_chosen_cnt);
+
         printk(KERN_INFO "NVMeVirt: [Hot/Cold Analysis]\n");
-        printk(KERN_INFO "NVMeVirt:  Total Sampled GC: %lu\n", total_gc_cnt);
-        printk(KERN_INFO "NVMeVirt:  🔥 Hot Victims : %lu\n", hot_gc_cnt);
-        printk(KERN_INFO "NVMeVirt:  🧊 Cold Victims: %lu\n", cold_gc_cnt);
-        printk(KERN_INFO "NVMeVirt:  🧊 Cold Ratio  : %lu%%\n", (cold_gc_cnt * 100) / total_gc_cnt);
-        printk(KERN_INFO "NVMeVirt:  Average Age  : %llu old\n", victim_total_age / victim_chosen_cnt);
+        printk(KERN_INFO "NVMeVirt:  Total Sampled GC: %llu\n", sampled);
+        printk(KERN_INFO "NVMeVirt:  🔥 Hot Victims : %llu\n", (uint64_t)atomic64_read(&hot_gc_cnt));
+        printk(KERN_INFO "NVMeVirt:  🧊 Cold Victims: %llu\n", cold);
+        printk(KERN_INFO "NVMeVirt:  🧊 Cold Ratio  : %llu%%\n", (cold * 100) / sampled);
+        printk(KERN_INFO "NVMeVirt:  Average Age  : %llu old\n",
+                chosen ? (uint64_t)atomic64_read(&victim_total_age) / chosen : 0);
     } else {
         printk(KERN_INFO "NVMeVirt: [Hot/Cold Analysis] No GC triggered yet.\n");
     }
@@ -1715,6 +3333,12 @@ bool conv_proc_nvme_io_cmd(struct nvmev_ns *ns, struct nvmev_request *req, struc
     case nvme_cmd_flush:
         conv_flush(ns, req, ret); // 플러시 함수 호출
         break;
+    case nvme_cmd_dsm:
+        conv_dsm(ns, req, ret); // Deallocate (TRIM)
+        break;
+    case nvme_cmd_write_zeroes:
+        conv_write_zeroes(ns, req, ret); // NAND 쓰기 없이 매핑 해제
+        break;
     default: // 구현되지 않은 명령
         NVMEV_ERROR("%s: command not implemented: %s (0x%x)\n", __func__,
                 nvme_opcode_string(cmd->common.opcode), cmd->common.opcode);
@@ -4,12 +4,19 @@
 #define _NVMEVIRT_CONV_FTL_H // 헤더 파일 중복 포함 방지 가드
 
 #include <linux/types.h>    // 리눅스 커널 기본 데이터 타입 정의
+#include <linux/wait.h>     // 파티션 스레드 대기 큐
+#include <linux/mutex.h>    // 파티션 잠금
 #include "pqueue/pqueue.h"  // 우선순위 큐 라이브러리 (GC 희생 블록 선정용)
 #include "ssd_config.h"     // SSD 설정 관련 헤더
 #include "ssd.h"            // SSD 기본 구조체 및 함수 헤더
 
 struct conv_ftl;
-typedef struct line *(*victim_select_fn)(struct conv_ftl *, bool);
+struct line_mgmt;
+typedef struct line *(*victim_select_fn)(struct conv_ftl *, struct line_mgmt *, bool);
+
+#define CB_AGE_TIERS 4 // Cost-Benefit 나이 구간 수 (get_age_weight의 계단 수)
+#define MAX_USER_STREAMS 4 // 온도별 유저 쓰기 스트림 최대 개수
+#define MAX_GC_GENS 4      // GC 목적지 세대(재배치 횟수별) 최대 개수
 // FTL 동작을 제어하는 파라미터 구조체
 struct convparams {
     uint32_t gc_thres_lines;      // GC를 시작할 프리 라인 개수 임계값 (이보다 적으면 GC 시작)
@@ -35,17 +42,25 @@ struct line {
     /* position in the priority queue for victim lines */
     size_t pos;                                             // 희생 라인 우선순위 큐 내부에서의 위치 인덱스
     uint64_t last_modified_time;                            // update된 즉 Invalid된 수정 시각을 기록해야함
+    int tier;                                               // CB 인덱스에서 속한 나이 구간
+    uint32_t gen;                                           // 세대: 0은 유저 쓰기, k는 k번째 GC 세대 포인터로 쓰인 라인
+    struct list_head tier_entry;                            // CB 나이 구간 리스트(시간순) 연결
+    bool slc;                                               // SLC 모드로 쓰는 라인 (지울 때마다 다시 결정)
+    bool victim;                                            // 희생 후보 상태 (인덱스와 별도로 유지, CB 검증 기준)
 };
 
 /* wp: record next write addr */                
 // 다음 쓰기 작업을 수행할 물리적 위치를 가리키는 포인터 구조체
 struct write_pointer {
     struct line *curline; // 현재 쓰기를 수행 중인 라인(슈퍼블록) 포인터
+    struct line_mgmt *lm; // 새 라인을 받아올 라인 관리자 (SLC/TLC)
+    uint32_t gen;         // 이 포인터가 여는 라인의 세대
     uint32_t ch;          // 현재 쓰기 채널 번호
     uint32_t lun;         // 현재 쓰기 LUN 번호
     uint32_t pg;          // 현재 쓰기 페이지 번호
     uint32_t blk;         // 현재 쓰기 블록 번호
     uint32_t pl;          // 현재 쓰기 플레인 번호
+    uint64_t gather_stime; // 현재 원샷 단위에 모인 데이터가 준비되는 시각 (GC 읽기 완료, 0: 즉시)
 };
 
 // 전체 라인들의 상태(Free, Victim, Full)를 관리하는 구조체
@@ -55,6 +70,8 @@ struct line_mgmt {
     /* free line list, we only need to maintain a list of blk numbers */
     struct list_head free_line_list; // 빈 라인(Free Line)들을 관리하는 리스트
     pqueue_t *victim_line_pq;        // 데이터가 차 있고 GC 대상이 될 라인들을 관리하는 우선순위 큐
+    pqueue_t *cb_tier_pq[CB_AGE_TIERS];         // CB 전용: 나이 구간별 VPC Min-Heap
+    struct list_head cb_tier_list[CB_AGE_TIERS]; // CB 전용: 나이 구간별 라인 리스트 (last_modified_time 순)
     victim_select_fn select_victim; //함수포인터로 init_lines에서 결정된 전략 함수(Greedy/Random/CB)가 들어감
     struct list_head full_line_list; // 완전히 꽉 찬(유효 페이지로만 구성된) 라인 리스트
 
@@ -70,17 +87,148 @@ struct write_flow_control {
     uint32_t credits_to_refill; // GC 수행 완료 후ㅋ₩ 리필할 크레딧 양
 };
 
+// LPN(묶음)별 업데이트 빈도 카운터 (온도 분류기)
+struct lpn_heat {
+    uint8_t cnt;    // 최근 업데이트 횟수 (epoch마다 절반으로 감쇠)
+    uint16_t epoch; // 마지막으로 감쇠를 반영한 epoch
+};
+
+// 이 epoch 수마다 온도 테이블 전체에 감쇠를 반영 (16비트 epoch 차이가 wrap되지 않도록 절반 이하)
+#define HEAT_SWEEP_EPOCHS (1U << 15)
+
+// 백그라운드(유휴 시간) GC 진행 상황 및 스로틀링 통계
+struct bg_gc_stat {
+    uint64_t next_time;     // 다음 백그라운드 GC를 허용할 시각 (ns, 스로틀링)
+    uint64_t nr_lines;      // 백그라운드 GC로 회수한 라인 수
+    uint64_t nr_copied;     // 백그라운드 GC가 복사한 유효 페이지 수
+    uint64_t nr_busy_skips; // 장치가 바빠서 건너뛴 횟수
+    uint64_t nr_no_victim;  // 조건에 맞는 희생 라인이 없어 건너뛴 횟수
+};
+
+/*
+ * 32비트 압축 매핑 엔트리: struct ppa 필드를 지오메트리에 맞는 최소 비트로 이어 붙인다.
+ * (하위부터 pg | blk | pl | lun | ch). 모든 비트가 1인 값은 UNMAPPED/INVALID로 예약.
+ */
+#define PPA32_UNMAPPED U32_MAX
+#define LPN32_INVALID U32_MAX
+
+struct ppa_codec {
+    uint8_t pg_bits, blk_bits, pl_bits, lun_bits; // 필드별 비트 수
+    uint8_t blk_shift, pl_shift, lun_shift, ch_shift;
+};
+
+// 증분 GC 진행 커서: 희생 라인을 (flashpg, ch, lun) 스텝 단위로 나눠 정리
+struct gc_cursor {
+    struct line *victim;  // 정리 중인 희생 라인 (NULL이면 진행 중인 GC 없음)
+    struct line_mgmt *lm; // 희생 라인이 속한 라인 관리자
+    uint32_t next_step;   // 다음에 정리할 스텝 (flashpg * nchs * luns_per_ch + ch * luns_per_ch + lun)
+};
+
+/*
+ * 순차 쓰기 스트림 감지기: 최근 스트림 몇 개의 다음 기대 LPN과 연속 길이를 추적.
+ * 명령 단위로 디스패처에서만 갱신하므로 파티션 0 인스턴스에만 둔다.
+ */
+#define SEQ_MAX_STREAMS 4
+
+struct seq_stream {
+    uint64_t next_lpn;  // 이 스트림이 이어질 경우의 다음 LPN (전역)
+    uint64_t run_pgs;   // 지금까지 연속으로 쓰인 페이지 수
+    uint64_t last_used; // LRU 교체용 명령 순번
+};
+
+struct seq_detect {
+    struct seq_stream streams[SEQ_MAX_STREAMS];
+    uint64_t nr_cmds; // 지금까지 본 쓰기 명령 수 (순번)
+};
+
+// 파티션 단위로 분할된 읽기/쓰기 작업 (파티션 스레드에서 실행)
+enum {
+    CONV_JOB_READ = 0,
+    CONV_JOB_WRITE = 1,
+};
+
+/*
+ * 파티션 스레드는 IO 워커 큐를 직접 건드릴 수 없으므로
+ * 쓰기 버퍼 반납 예약을 작업에 모아 두었다가 디스패처가 회수할 때 등록한다.
+ */
+#define CONV_MAX_DEFERRED_IOPS 32
+
+struct conv_deferred_iop {
+    uint64_t nsecs_target; // 반납 시각
+    size_t size;           // 반납할 버퍼 크기
+};
+
+/*
+ * 파티션 스레드에 작업을 넘긴 명령. 모든 작업이 회수되면 결과를 IO 워커에 넘긴다.
+ * 명령을 받은 디스패처만 다루므로 잠금이 필요 없다.
+ */
+#define CONV_MAX_PENDING_CMDS 1024
+
+struct conv_cmd {
+    struct nvmev_request req; // 결과를 넘길 요청
+    uint64_t nsecs_latest;    // 지금까지 끝난 작업의 최종 완료 시각
+    uint32_t nr_jobs;         // 남은 작업 수 (+ 제출 중에는 1)
+    struct conv_cmd *next;    // 빈 컨텍스트 리스트
+};
+
+// 디스패처 하나가 쓰는 명령 컨텍스트 풀
+struct conv_cmd_pool {
+    struct conv_cmd *cmds;      // CONV_MAX_PENDING_CMDS개
+    struct conv_cmd *free_cmds; // 빈 컨텍스트 리스트
+} ____cacheline_aligned_in_smp;
+
+struct conv_part_job {
+    int type;              // CONV_JOB_READ / CONV_JOB_WRITE
+    bool bypass_slc;       // 순차 스트림 쓰기: SLC 버퍼를 건너뛰고 TLC에 바로 기록
+    uint32_t nr_parts;     // 파티션 수 (LPN 스트라이드)
+    uint64_t start_lpn;    // 이 파티션이 담당하는 첫 LPN (전역)
+    uint64_t end_lpn;      // 요청 전체의 마지막 LPN (전역)
+    uint64_t stime;        // NAND 명령 시작 시각
+    uint64_t nsecs_latest; // [out] 이 파티션의 최종 완료 시각
+
+    int sq_id;             // 쓰기 버퍼 반납을 등록할 SQ
+    struct conv_cmd *cmd;  // 결과를 기다리는 명령 (이미 완료된 쓰기는 NULL)
+    uint32_t nr_deferred_iops;
+    struct conv_deferred_iop deferred_iops[CONV_MAX_DEFERRED_IOPS];
+};
+
+// 파티션 작업 큐 깊이 (2의 승수). 명령을 넘나들며 쌓이므로 join 없이 파이프라인된다
+#define CONV_PART_QUEUE_DEPTH 256
+
+/*
+ * 디스패처 하나와 파티션 스레드 하나 사이의 작업 큐.
+ * 디스패처가 넣고(tail) 파티션 스레드가 실행하며(done) 넣은 디스패처가 결과를 회수한다(reaped).
+ * done만 파티션 스레드가 쓴다.
+ */
+struct conv_job_queue {
+    struct conv_part_job *jobs; // CONV_PART_QUEUE_DEPTH개
+    unsigned int tail ____cacheline_aligned_in_smp;
+    unsigned int reaped;
+    unsigned int done ____cacheline_aligned_in_smp;
+};
+// 큐가 빈 뒤 잠들기 전까지 새 작업을 기다리는 시간
+#define CONV_PART_SPIN_NS (50 * 1000)
+
 // Conventional FTL의 메인 구조체
 struct conv_ftl {
     struct ssd *ssd; // 하부 SSD 하드웨어 모델에 대한 포인터
 
     struct convparams cp;       // FTL 파라미터 설정값
-    struct ppa *maptbl; /* page level mapping table */         // 논리 주소(LPN) -> 물리 주소(PPA) 매핑 테이블
-    uint64_t *rmap; /* reverse mapptbl, assume it's stored in OOB */ // 물리 주소 -> 논리 주소 역매핑 테이블 (GC시 사용, OOB 영역 가정)
+    bool compact_map;           // 32비트 매핑 엔트리 사용 여부 (지오메트리가 맞을 때만)
+    struct ppa_codec codec;     // 32비트 PPA 인코딩 정보
+    union {
+        struct ppa *maptbl; /* page level mapping table */ // 논리 주소(LPN) -> 물리 주소(PPA) 매핑 테이블
+        uint32_t *maptbl32;                                // 압축 형식
+    };
+    union {
+        uint64_t *rmap; /* reverse mapptbl, assume it's stored in OOB */ // 물리 주소 -> 논리 주소 역매핑 테이블 (GC시 사용, OOB 영역 가정)
+        uint32_t *rmap32;                                                // 압축 형식
+    };
     struct write_pointer slc_wp;
-    struct write_pointer tlc_wp;
-    struct write_pointer gc_wp; // GC 데이터(유효 페이지 이동) 쓰기를 위한 포인터
+    struct write_pointer tlc_wp[MAX_USER_STREAMS]; // 스트림(온도)별 유저 쓰기 포인터
+    struct write_pointer gc_wp[MAX_GC_GENS]; // GC 데이터(유효 페이지 이동) 쓰기를 위한 세대별 포인터
     struct write_pointer migration_wp;
+    struct line *lines;         // 전체 라인 배열 (SLC/TLC 공용, 인덱스 = 블록 번호)
     struct line_mgmt slc_lm;
     struct line_mgmt tlc_lm;
     struct write_flow_control slc_wfc;
@@ -88,9 +236,69 @@ struct conv_ftl {
 
     uint64_t gc_count;              // 총 GC 수행 횟수
     uint64_t gc_copied_pages;       // GC로 복사된 총 페이지 수
+    uint64_t fg_gc_count;           // 쓰기 경로에서 수행된 긴급(Foreground) GC 횟수
+    struct gc_cursor gc_cur;        // 증분 GC 진행 상태 (TLC)
+    struct gc_cursor mg_cur;        // 증분 마이그레이션 진행 상태 (SLC)
+    uint64_t incr_gc_steps;         // 증분 모드로 진행한 스텝 수
+    uint64_t incr_gc_forced;        // 크레딧 안에 못 끝내 한 번에 마무리한 횟수
+    struct bg_gc_stat bg_gc;        // 백그라운드 GC 통계
+    struct bg_gc_stat bg_mg;        // 유휴 시간 SLC->TLC 마이그레이션 통계
+    uint64_t mg_count;              // 마이그레이션으로 정리한 SLC 라인 수
+    uint64_t mg_retained_pgs;       // 마이그레이션 중 SLC에 다시 쓴 Hot 페이지 수
+    uint64_t mg_migrated_pgs;       // 마이그레이션 중 TLC로 내려보낸 페이지 수
+    uint32_t mg_victim_retained;    // 정리 중인 마이그레이션 희생 라인에서 SLC에 남긴 페이지 수
+    uint32_t mg_victim_migrated;    // 정리 중인 마이그레이션 희생 라인에서 TLC로 보낸 페이지 수
+    uint64_t cb_validate_cnt;       // CB 인덱스 검증 횟수
+    uint64_t cb_validate_mismatch;  // CB 인덱스와 선형 스캔 결과가 다른 횟수
 
     bool slc_enabled;
-    u32 slc_line_limit;
+    u32 slc_line_limit;         // SLC 라인 수 상한 (동적 SLC가 꺼져 있으면 고정 크기)
+    u32 slc_min_lines;          // SLC 라인 수 하한 (SLC_PORTION)
+    u32 slc_dyn_reserve;        // SLC가 TLC 라인을 빌리지 않고 남겨둘 TLC 여유 라인 수
+    uint64_t slc_grown;         // TLC -> SLC 전환 횟수
+    uint64_t slc_shrunk;        // SLC -> TLC 전환 횟수
+    uint64_t tlc_vpc;           // TLC 라인의 유효 페이지 수 (SLC 확장 여부 판단용)
+
+    /* 유저 쓰기 스트림 (Hot/Cold 분리) */
+    uint32_t nr_streams;                          // 사용 중인 유저 스트림 수
+    struct lpn_heat *heat;                        // 온도 분류기 테이블
+    uint16_t heat_epoch;                          // 현재 감쇠 epoch
+    uint64_t nr_heat_ents;                        // 온도 테이블 엔트리 수
+    uint64_t heat_sweep_pos;                      // 다음 epoch에 감쇠를 반영할 엔트리
+    uint64_t heat_sweep_step;                     // epoch마다 감쇠를 반영할 엔트리 수
+    uint64_t heat_pgs_written;                    // 현재 epoch 동안 쓰인 유저 페이지 수
+    uint64_t heat_decay_pgs;                      // epoch 길이 (유저 페이지 수)
+    uint64_t stream_user_pgs[MAX_USER_STREAMS];   // 스트림별 유저 쓰기 페이지 수
+    uint64_t stream_gc_pgs[MAX_USER_STREAMS];     // 스트림별 GC 복사 페이지 수 (WAF 계산용)
+    uint64_t stream_retained_pgs[MAX_USER_STREAMS]; // 스트림별 마이그레이션 SLC 유지 페이지 수
+
+    /* 세대별 GC 목적지 */
+    uint32_t nr_gc_gens;                          // 사용 중인 GC 세대 수
+    uint64_t gc_gen_copied[MAX_GC_GENS];          // 세대별 GC 복사 페이지 수
+
+    /* 순차 스트림 SLC 우회 */
+    struct seq_detect seq;                        // 순차 스트림 감지기 (파티션 0만 사용)
+    spinlock_t seq_lock;                          // 여러 디스패처가 seq를 함께 갱신한다
+    uint64_t seq_bypass_pgs;                      // SLC를 건너뛰고 TLC에 바로 쓴 유저 페이지 수
+
+    /* DSM deallocate / Write Zeroes */
+    uint64_t trimmed_pgs;                         // 매핑 해제된 페이지 수
+
+    /*
+     * 파티션 상태(매핑, 라인, 크레딧, GC 커서 등)는 lock이 보호한다.
+     * 작업을 실행하는 쪽(파티션 스레드, 스레드가 없으면 디스패처)과
+     * 트림, 유휴 시간 작업이 잡으므로 파티션이 다르면 서로 막지 않는다.
+     */
+    struct mutex lock;
+
+    /* 파티션 병렬 실행: 디스패처마다 작업 큐를 하나씩 두어 잠금 없이 작업을 넣는다 */
+    struct task_struct *part_worker;              // 전용 스레드 (NULL이면 디스패처에서 실행)
+    struct conv_job_queue *jqs;                   // 디스패처별 작업 큐 (nr_jqs개)
+    uint32_t nr_jqs;
+    wait_queue_head_t job_wq;                     // 큐가 모두 비면 파티션 스레드가 여기서 잠든다
+
+    /* 파티션 스레드에 넘긴 명령의 디스패처별 컨텍스트 풀 (0번 인스턴스만 사용) */
+    struct conv_cmd_pool *pools;
 };
 
 // 네임스페이스 초기화 및 FTL 인스턴스 생성 함수 선언
@@ -104,4 +312,7 @@ void conv_remove_namespace(struct nvmev_ns *ns);
 bool conv_proc_nvme_io_cmd(struct nvmev_ns *ns, struct nvmev_request *req,
                struct nvmev_result *ret);
 
+// 디스패처 유휴 시 백그라운드 작업(GC)을 수행하는 함수 선언
+void conv_proc_idle(struct nvmev_ns *ns);
+
 #endif
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <linux/ktime.h>
 #include <linux/highmem.h>
 #include <linux/sched/clock.h>
+#include <linux/random.h>
+#include <linux/vmalloc.h>
 
 #include "nvmev.h"
 #include "dma.h"
@@ -25,12 +27,17 @@ extern bool io_using_dma;
 static inline unsigned int __get_io_worker(int sqid)
 {
 #ifdef CONFIG_NVMEV_IO_WORKER_BY_SQ
-	return (sqid - 1) % nvmev_vdev->config.nr_io_workers;
+	return READ_ONCE(nvmev_vdev->sq_io_workers[sqid]);
 #else
 	return nvmev_vdev->io_worker_turn;
 #endif
 }
 
+static inline unsigned int __get_dispatcher(int sqid)
+{
+	return (sqid - 1) % nvmev_vdev->config.nr_dispatchers;
+}
+
 static inline unsigned long long __get_wallclock(void)
 {
 	return cpu_clock(nvmev_vdev->config.cpu_nr_dispatcher);
@@ -46,6 +53,76 @@ static inline size_t __cmd_io_size(struct nvme_rw_command *cmd)
 	return (cmd->length + 1) << LBA_BITS;
 }
 
+/*
+ * Commands without data pages. Write Zeroes clears the backing storage here
+ * so that it is ordered with the data copies of earlier writes; DSM carries
+ * only a range list which the FTL has consumed at dispatch time.
+ * Returns true if @cmd has been handled.
+ */
+static bool __do_perform_io_nodata(struct nvme_rw_command *cmd)
+{
+	size_t nsid = cmd->nsid - 1; // 0-based
+	struct nvmev_ns *ns = &nvmev_vdev->ns[nsid];
+	u64 nr_lbas = ns->size >> LBA_BITS;
+
+	switch (cmd->opcode) {
+	case nvme_cmd_write_zeroes:
+		/*
+		 * Out-of-range commands have been failed by the FTL but still come
+		 * here; leave the storage alone. Compare in LBAs so that a huge SLBA
+		 * cannot wrap the byte offset around.
+		 */
+		if (cmd->slba >= nr_lbas || (u64)cmd->length + 1 > nr_lbas - cmd->slba)
+			return true;
+		memset(ns->mapped + __cmd_io_offset(cmd), 0, __cmd_io_size(cmd));
+		return true;
+	case nvme_cmd_dsm:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Copy a small host buffer described by @prp1/@prp2 (at most two pages, e.g.,
+ * the DSM range list) into @buf. Returns the number of bytes copied.
+ */
+size_t nvmev_copy_from_prp(u64 prp1, u64 prp2, void *buf, size_t len)
+{
+	size_t copied = 0;
+	u64 paddr = prp1;
+
+	len = min_t(size_t, len, PAGE_SIZE);
+
+	while (copied < len) {
+		size_t mem_offs = paddr & PAGE_OFFSET_MASK;
+		size_t io_size = min_t(size_t, len - copied, PAGE_SIZE - mem_offs);
+		void *vaddr;
+		bool is_memremap = false;
+
+		if (pfn_valid(paddr >> PAGE_SHIFT)) {
+			vaddr = kmap_atomic_pfn(PRP_PFN(paddr));
+		} else {
+			vaddr = memremap(paddr - mem_offs, PAGE_SIZE, MEMREMAP_WT);
+			is_memremap = true;
+		}
+		if (!vaddr)
+			break;
+
+		memcpy(buf + copied, vaddr + mem_offs, io_size);
+
+		if (is_memremap)
+			memunmap(vaddr);
+		else
+			kunmap_atomic(vaddr);
+
+		copied += io_size;
+		paddr = prp2;
+	}
+
+	return copied;
+}
+
 static unsigned int __do_perform_io(int sqid, int sq_entry)
 {
 	struct nvmev_submission_queue *sq = nvmev_vdev->sqes[sqid];
@@ -59,6 +136,9 @@ static unsigned int __do_perform_io(int sqid, int sq_entry)
 	size_t nsid = cmd->nsid - 1; // 0-based
 	bool is_paddr_memremap = false;
 
+	if (__do_perform_io_nodata(cmd))
+		return 0;
+
 	offset = __cmd_io_offset(cmd);
 	length = __cmd_io_size(cmd);
 	remaining = length;
@@ -153,6 +233,9 @@ static unsigned int __do_perform_io_using_dma(int sqid, int sq_entry)
 	size_t mem_offs = 0;
 	bool is_memremap = false;
 
+	if (__do_perform_io_nodata(cmd))
+		return 0;
+
 	offset = __cmd_io_offset(cmd);
 	length = __cmd_io_size(cmd);
 	remaining = length;
@@ -245,50 +328,69 @@ static unsigned int __do_perform_io_using_dma(int sqid, int sq_entry)
 	return length;
 }
 
-static void __insert_req_sorted(unsigned int entry, struct nvmev_io_worker *worker,
-				unsigned long nsecs_target)
+/*
+ * Work entries are handed between the dispatcher and an IO worker through
+ * two single-producer/single-consumer rings of entry indexes. The dispatcher
+ * fills a free entry and pushes it to @sub_ring; the worker owns it from then
+ * on, keeps it in @io_tree until its target time and pushes it back through
+ * @done_ring. An entry is thus only written by one side at a time, and the
+ * only shared writes on the hot path are the ring indexes.
+ */
+static inline void __io_ring_push(struct nvmev_io_ring *ring, unsigned int entry)
 {
-	/**
-	 * Requests are placed in @work_queue sorted by their target time.
-	 * @work_queue is statically allocated and the ordered list is
-	 * implemented by chaining the indexes of entries with @prev and @next.
-	 * This implementation is nasty but we do this way over dynamically
-	 * allocated linked list to minimize the influence of dynamic memory allocation.
-	 * Also, this O(n) implementation can be improved to O(logn) scheme with
-	 * e.g., red-black tree but....
-	 */
-	if (worker->io_seq == -1) {
-		worker->io_seq = entry;
-		worker->io_seq_end = entry;
-	} else {
-		unsigned int curr = worker->io_seq_end;
-
-		while (curr != -1) {
-			if (worker->work_queue[curr].nsecs_target <= worker->latest_nsecs)
-				break;
+	unsigned int tail = ring->tail;
 
-			if (worker->work_queue[curr].nsecs_target <= nsecs_target)
-				break;
+	ring->slots[tail & (NR_MAX_PARALLEL_IO - 1)] = entry;
+	smp_store_release(&ring->tail, tail + 1); /* Publish the entry with its slot */
+}
 
-			curr = worker->work_queue[curr].prev;
-		}
+static inline bool __io_ring_pop(struct nvmev_io_ring *ring, unsigned int *entry)
+{
+	unsigned int head = ring->head;
+
+	if (head == smp_load_acquire(&ring->tail))
+		return false;
+
+	*entry = ring->slots[head & (NR_MAX_PARALLEL_IO - 1)];
+	smp_store_release(&ring->head, head + 1);
+	return true;
+}
 
-		if (curr == -1) { /* Head inserted */
-			worker->work_queue[worker->io_seq].prev = entry;
-			worker->work_queue[entry].next = worker->io_seq;
-			worker->io_seq = entry;
-		} else if (worker->work_queue[curr].next == -1) { /* Tail */
-			worker->work_queue[entry].prev = curr;
-			worker->io_seq_end = entry;
-			worker->work_queue[curr].next = entry;
-		} else { /* In between */
-			worker->work_queue[entry].prev = curr;
-			worker->work_queue[entry].next = worker->work_queue[curr].next;
-
-			worker->work_queue[worker->work_queue[entry].next].prev = entry;
-			worker->work_queue[curr].next = entry;
+static void __insert_req_sorted(unsigned int entry, struct nvmev_io_worker *worker)
+{
+	/**
+	 * Requests are kept in @io_tree, a red-black tree ordered by their target
+	 * time, so that the worker inserts in O(log n) and finds the earliest
+	 * request in O(1). Tree nodes are embedded in the statically allocated
+	 * @work_queue entries to avoid dynamic memory allocation. Requests with the
+	 * same target are completed in the order they were dispatched.
+	 */
+	struct nvmev_io_work *w = &worker->work_queue[entry];
+	struct rb_node **link = &worker->io_tree.rb_root.rb_node, *parent = NULL;
+	bool leftmost = true;
+
+	while (*link) {
+		parent = *link;
+		if (w->nsecs_target < rb_entry(parent, struct nvmev_io_work, rb)->nsecs_target) {
+			link = &parent->rb_left;
+		} else {
+			link = &parent->rb_right;
+			leftmost = false;
 		}
 	}
+	rb_link_node(&w->rb, parent, link);
+	rb_insert_color_cached(&w->rb, &worker->io_tree, leftmost);
+}
+
+/* Take back the entries completed by @worker into its free stack */
+static void __reclaim_worker(struct nvmev_io_worker *worker)
+{
+	unsigned int entry;
+
+	while (__io_ring_pop(&worker->done_ring, &entry)) {
+		worker->work_queue[entry].next = worker->free_seq;
+		worker->free_seq = entry;
+	}
 }
 
 static struct nvmev_io_worker *__allocate_work_queue_entry(int sqid, unsigned int *entry)
@@ -296,19 +398,21 @@ static struct nvmev_io_worker *__allocate_work_queue_entry(int sqid, unsigned in
 	unsigned int io_worker_turn = __get_io_worker(sqid);
 	struct nvmev_io_worker *worker = &nvmev_vdev->io_workers[io_worker_turn];
 	unsigned int e = worker->free_seq;
-	struct nvmev_io_work *w = worker->work_queue + e;
 
-	if (w->next >= NR_MAX_PARALLEL_IO) {
-		WARN_ON_ONCE("IO queue is almost full");
-		return NULL;
+	if (e == -1) {
+		__reclaim_worker(worker);
+		e = worker->free_seq;
+		if (e == -1) {
+			WARN_ON_ONCE("IO queue is full");
+			return NULL;
+		}
 	}
 
 	if (++io_worker_turn == nvmev_vdev->config.nr_io_workers)
 		io_worker_turn = 0;
 	nvmev_vdev->io_worker_turn = io_worker_turn;
 
-	worker->free_seq = w->next;
-	BUG_ON(worker->free_seq >= NR_MAX_PARALLEL_IO);
+	worker->free_seq = worker->work_queue[e].next;
 	*entry = e;
 
 	return worker;
@@ -343,13 +447,11 @@ static void __enqueue_io_req(int sqid, int cqid, int sq_entry, unsigned long lon
 	w->status = ret->status;
 	w->is_completed = false;
 	w->is_copied = false;
-	w->prev = -1;
 	w->next = -1;
 
 	w->is_internal = false;
-	mb(); /* IO worker shall see the updated w at once */
 
-	__insert_req_sorted(entry, worker, ret->nsecs_target);
+	__io_ring_push(&worker->sub_ring, entry);
 }
 
 void schedule_internal_operation(int sqid, unsigned long long nsecs_target,
@@ -374,66 +476,23 @@ void schedule_internal_operation(int sqid, unsigned long long nsecs_target,
 	w->nsecs_target = nsecs_target;
 	w->is_completed = false;
 	w->is_copied = true;
-	w->prev = -1;
 	w->next = -1;
 
 	w->is_internal = true;
 	w->write_buffer = write_buffer;
 	w->buffs_to_release = buffs_to_release;
-	mb(); /* IO worker shall see the updated w at once */
 
-	__insert_req_sorted(entry, worker, nsecs_target);
+	__io_ring_push(&worker->sub_ring, entry);
 }
 
-static void __reclaim_completed_reqs(void)
+/* Reclaim from the IO workers fed by @dispatcher only */
+static void __reclaim_completed_reqs(unsigned int dispatcher)
 {
 	unsigned int turn;
 
-	for (turn = 0; turn < nvmev_vdev->config.nr_io_workers; turn++) {
-		struct nvmev_io_worker *worker;
-		struct nvmev_io_work *w;
-
-		unsigned int first_entry = -1;
-		unsigned int last_entry = -1;
-		unsigned int curr;
-		int nr_reclaimed = 0;
-
-		worker = &nvmev_vdev->io_workers[turn];
-
-		first_entry = worker->io_seq;
-		curr = first_entry;
-
-		while (curr != -1) {
-			w = &worker->work_queue[curr];
-			if (w->is_completed == true && w->is_copied == true &&
-			    w->nsecs_target <= worker->latest_nsecs) {
-				last_entry = curr;
-				curr = w->next;
-				nr_reclaimed++;
-			} else {
-				break;
-			}
-		}
-
-		if (last_entry != -1) {
-			w = &worker->work_queue[last_entry];
-			worker->io_seq = w->next;
-			if (w->next != -1) {
-				worker->work_queue[w->next].prev = -1;
-			}
-			w->next = -1;
-
-			w = &worker->work_queue[first_entry];
-			w->prev = worker->free_seq_end;
-
-			w = &worker->work_queue[worker->free_seq_end];
-			w->next = first_entry;
-
-			worker->free_seq_end = last_entry;
-			NVMEV_DEBUG_VERBOSE("%s: %u -- %u, %d\n", __func__,
-					first_entry, last_entry, nr_reclaimed);
-		}
-	}
+	for (turn = dispatcher; turn < nvmev_vdev->config.nr_io_workers;
+	     turn += nvmev_vdev->config.nr_dispatchers)
+		__reclaim_worker(&nvmev_vdev->io_workers[turn]);
 }
 
 static size_t __nvmev_proc_io(int sqid, int sq_entry, size_t *io_size)
@@ -451,6 +510,8 @@ static size_t __nvmev_proc_io(int sqid, int sq_entry, size_t *io_size)
 	struct nvmev_request req = {
 		.cmd = cmd,
 		.sq_id = sqid,
+		.sq_entry = sq_entry,
+		.disp_id = __get_dispatcher(sqid),
 		.nsecs_start = nsecs_start,
 	};
 	struct nvmev_result ret = {
@@ -469,21 +530,32 @@ static size_t __nvmev_proc_io(int sqid, int sq_entry, size_t *io_size)
 	static unsigned long long counter = 0;
 #endif
 
-	if (!ns->proc_io_cmd(ns, &req, &ret))
+	if (nvmev_vdev->config.nr_dispatchers > 1 && !ns->concurrent) {
+		bool handled;
+
+		mutex_lock(&ns->lock);
+		handled = ns->proc_io_cmd(ns, &req, &ret);
+		mutex_unlock(&ns->lock);
+		if (!handled)
+			return false;
+	} else if (!ns->proc_io_cmd(ns, &req, &ret)) {
 		return false;
+	}
 	*io_size = __cmd_io_size(&sq_entry(sq_entry).rw);
 
 #ifdef PERF_DEBUG
 	prev_clock2 = local_clock();
 #endif
 
-	__enqueue_io_req(sqid, sq->cqid, sq_entry, nsecs_start, &ret);
+	/* Deferred results are handed over later through nvmev_complete_deferred() */
+	if (!ret.deferred)
+		__enqueue_io_req(sqid, sq->cqid, sq_entry, nsecs_start, &ret);
 
 #ifdef PERF_DEBUG
 	prev_clock3 = local_clock();
 #endif
 
-	__reclaim_completed_reqs();
+	__reclaim_completed_reqs(__get_dispatcher(sqid));
 
 #ifdef PERF_DEBUG
 	prev_clock4 = local_clock();
@@ -505,6 +577,21 @@ static size_t __nvmev_proc_io(int sqid, int sq_entry, size_t *io_size)
 	return true;
 }
 
+/*
+ * Hand over the result of @req, which the namespace deferred in proc_io_cmd.
+ * Called from proc_pending, i.e., by the dispatcher serving @req->sq_id, as
+ * the IO workers take requests from a single dispatcher only.
+ */
+void nvmev_complete_deferred(struct nvmev_request *req, struct nvmev_result *ret)
+{
+	struct nvmev_submission_queue *sq = nvmev_vdev->sqes[req->sq_id];
+
+	if (unlikely(!sq))
+		return;
+
+	__enqueue_io_req(req->sq_id, sq->cqid, req->sq_entry, req->nsecs_start, ret);
+}
+
 int nvmev_proc_io_sq(int sqid, int new_db, int old_db)
 {
 	struct nvmev_submission_queue *sq = nvmev_vdev->sqes[sqid];
@@ -541,6 +628,10 @@ void nvmev_proc_io_cq(int cqid, int new_db, int old_db)
 {
 	struct nvmev_completion_queue *cq = nvmev_vdev->cqes[cqid];
 	int i;
+
+	if (unlikely(!cq))
+		return;
+
 	for (i = old_db; i != new_db; i++) {
 		int sqid = cq_entry(i).sq_id;
 		if (i >= cq->queue_size) {
@@ -560,7 +651,7 @@ void nvmev_proc_io_cq(int cqid, int new_db, int old_db)
 		cq->cq_tail = cq->queue_size - 1;
 }
 
-static void __fill_cq_result(struct nvmev_io_work *w)
+static void __fill_cq_result(struct nvmev_io_work *w, unsigned long long nsecs)
 {
 	int sqid = w->sqid;
 	int cqid = w->cqid;
@@ -592,9 +683,33 @@ static void __fill_cq_result(struct nvmev_io_work *w)
 
 	cq->cq_head = cq_head;
 	cq->interrupt_ready = true;
+	if (cq->nr_pending_irqs++ == 0)
+		cq->nsecs_first_pending = nsecs;
+	cq->nr_cqes++;
 	spin_unlock(&cq->entry_lock);
 }
 
+/*
+ * Interrupt coalescing per Set Features - Interrupt Coalescing. The interrupt
+ * of @cq is held back until more than THR entries are pending, or until TIME
+ * has passed since the first of them was posted. A THR or TIME of 0 means no
+ * coalescing, and so does Coalescing Disable on the vector of @cq.
+ */
+static bool __is_irq_due(struct nvmev_completion_queue *cq, unsigned long long nsecs)
+{
+	unsigned int thr = READ_ONCE(nvmev_vdev->irq_coalesce_thr);
+	unsigned int time = READ_ONCE(nvmev_vdev->irq_coalesce_time);
+
+	if (thr == 0 || time == 0)
+		return true;
+	if (cq->irq_vector > NR_MAX_IO_QUEUE ||
+	    READ_ONCE(nvmev_vdev->irq_coalesce_disabled[cq->irq_vector]))
+		return true;
+
+	return cq->nr_pending_irqs > thr ||
+	       nsecs >= cq->nsecs_first_pending + time * 100000ULL;
+}
+
 static int nvmev_io_worker(void *data)
 {
 	struct nvmev_io_worker *worker = (struct nvmev_io_worker *)data;
@@ -616,26 +731,19 @@ static int nvmev_io_worker(void *data)
 		unsigned long long curr_nsecs_local = local_clock();
 		long long delta = curr_nsecs_wall - curr_nsecs_local;
 
-		volatile unsigned int curr = worker->io_seq;
+		struct rb_node *node;
+		unsigned int curr;
 		int qidx;
 
-		while (curr != -1) {
+		/* Take new requests from the dispatcher and copy their data right away */
+		while (__io_ring_pop(&worker->sub_ring, &curr)) {
 			struct nvmev_io_work *w = &worker->work_queue[curr];
-			unsigned long long curr_nsecs = local_clock() + delta;
-			worker->latest_nsecs = curr_nsecs;
-
-			if (w->is_completed == true) {
-				curr = w->next;
-				continue;
-			}
 
 			if (w->is_copied == false) {
 #ifdef PERF_DEBUG
 				w->nsecs_copy_start = local_clock() + delta;
 #endif
-				if (w->is_internal) {
-					;
-				} else if (io_using_dma) {
+				if (io_using_dma) {
 					__do_perform_io_using_dma(w->sqid, w->sq_entry);
 				} else {
 #if (BASE_SSD == KV_PROTOTYPE)
@@ -663,33 +771,41 @@ static int nvmev_io_worker(void *data)
 					    w->sqid, w->cqid, w->sq_entry);
 			}
 
-			if (w->nsecs_target <= curr_nsecs) {
-				if (w->is_internal) {
+			__insert_req_sorted(curr, worker);
+		}
+
+		/* Complete requests whose target time has come, earliest first */
+		while ((node = rb_first_cached(&worker->io_tree))) {
+			struct nvmev_io_work *w = rb_entry(node, struct nvmev_io_work, rb);
+			unsigned long long curr_nsecs = local_clock() + delta;
+
+			if (w->nsecs_target > curr_nsecs)
+				break;
+
+			curr = w - worker->work_queue;
+			if (w->is_internal) {
 #if (SUPPORTED_SSD_TYPE(CONV) || SUPPORTED_SSD_TYPE(ZNS))
-					buffer_release((struct buffer *)w->write_buffer,
-						       w->buffs_to_release);
+				buffer_release((struct buffer *)w->write_buffer, w->buffs_to_release);
 #endif
-				} else {
-					__fill_cq_result(w);
-				}
+			} else {
+				__fill_cq_result(w, curr_nsecs);
+			}
 
-				NVMEV_DEBUG_VERBOSE("%s: completed %u, %d %d %d\n", worker->thread_name, curr,
-					    w->sqid, w->cqid, w->sq_entry);
+			NVMEV_DEBUG_VERBOSE("%s: completed %u, %d %d %d\n", worker->thread_name, curr,
+				    w->sqid, w->cqid, w->sq_entry);
 
 #ifdef PERF_DEBUG
-				w->nsecs_cq_filled = local_clock() + delta;
-				trace_printk("%llu %llu %llu %llu %llu %llu\n", w->nsecs_start,
-					     w->nsecs_enqueue - w->nsecs_start,
-					     w->nsecs_copy_start - w->nsecs_start,
-					     w->nsecs_copy_done - w->nsecs_start,
-					     w->nsecs_cq_filled - w->nsecs_start,
-					     w->nsecs_target - w->nsecs_start);
+			w->nsecs_cq_filled = local_clock() + delta;
+			trace_printk("%llu %llu %llu %llu %llu %llu\n", w->nsecs_start,
+				     w->nsecs_enqueue - w->nsecs_start,
+				     w->nsecs_copy_start - w->nsecs_start,
+				     w->nsecs_copy_done - w->nsecs_start,
+				     w->nsecs_cq_filled - w->nsecs_start,
+				     w->nsecs_target - w->nsecs_start);
 #endif
-				mb(); /* Reclaimer shall see after here */
-				w->is_completed = true;
-			}
-
-			curr = w->next;
+			rb_erase_cached(node, &worker->io_tree);
+			w->is_completed = true;
+			__io_ring_push(&worker->done_ring, curr);
 		}
 
 		for (qidx = 1; qidx <= nvmev_vdev->nr_cq; qidx++) {
@@ -703,11 +819,16 @@ static int nvmev_io_worker(void *data)
 				continue;
 
 			if (mutex_trylock(&cq->irq_lock)) {
-				if (cq->interrupt_ready == true) {
+				if (cq->interrupt_ready == true &&
+				    __is_irq_due(cq, local_clock() + delta)) {
 #ifdef PERF_DEBUG
 					prev_clock = local_clock();
 #endif
+					spin_lock(&cq->entry_lock);
 					cq->interrupt_ready = false;
+					cq->nr_pending_irqs = 0;
+					cq->nr_irqs++;
+					spin_unlock(&cq->entry_lock);
 					nvmev_signal_irq(cq->irq_vector);
 
 #ifdef PERF_DEBUG
@@ -735,37 +856,208 @@ static int nvmev_io_worker(void *data)
 	return 0;
 }
 
+/* Returns the NUMA node holding @paddr, or NUMA_NO_NODE if it is not known */
+int nvmev_phys_to_node(unsigned long paddr)
+{
+	unsigned long pfn = PHYS_PFN(paddr);
+	int nid;
+
+	/* Reserved ranges have no struct page, so look at the node spans instead */
+	for_each_online_node(nid) {
+		if (pfn >= node_start_pfn(nid) && pfn < node_end_pfn(nid))
+			return nid;
+	}
+	return NUMA_NO_NODE;
+}
+
+static inline int __get_io_worker_node(unsigned int worker_id)
+{
+	return cpu_to_node(nvmev_vdev->config.cpu_nr_io_workers[worker_id]);
+}
+
+/*
+ * Pick the IO worker servicing @sqid. Only the workers fed by the dispatcher
+ * of @sqid are eligible, as each worker has a single producer. Among them,
+ * ones on the node preferred by numa_policy are taken in turn; if there is no
+ * such worker, fall back to (sqid - 1) % nr_io_workers.
+ */
+void NVMEV_IO_WORKER_MAP_SQ(int sqid, int sq_node)
+{
+	const unsigned int nr_io_workers = nvmev_vdev->config.nr_io_workers;
+	const unsigned int nr_dispatchers = nvmev_vdev->config.nr_dispatchers;
+	unsigned int worker_id = (sqid - 1) % nr_io_workers;
+	unsigned int nr_local = 0, i;
+	int node = NUMA_NO_NODE;
+
+	if (nvmev_vdev->config.numa_policy == NUMA_POLICY_STORAGE)
+		node = nvmev_vdev->config.storage_node;
+	else if (nvmev_vdev->config.numa_policy == NUMA_POLICY_SQ)
+		node = sq_node;
+
+	if (node != NUMA_NO_NODE) {
+		for (i = __get_dispatcher(sqid); i < nr_io_workers; i += nr_dispatchers) {
+			if (__get_io_worker_node(i) == node)
+				nr_local++;
+		}
+	}
+
+	if (nr_local) {
+		/* SQs of a dispatcher are (sqid - 1) / nr_dispatchers apart */
+		unsigned int nth = ((sqid - 1) / nr_dispatchers) % nr_local;
+
+		for (i = __get_dispatcher(sqid); i < nr_io_workers; i += nr_dispatchers) {
+			if (__get_io_worker_node(i) == node && nth-- == 0) {
+				worker_id = i;
+				break;
+			}
+		}
+	}
+
+	WRITE_ONCE(nvmev_vdev->sq_io_workers[sqid], worker_id);
+	NVMEV_DEBUG("sq %d: node %d, io_worker %u (node %d)\n", sqid, sq_node, worker_id,
+		    __get_io_worker_node(worker_id));
+}
+
+static void __report_numa_placement(struct nvmev_dev *nvmev_vdev)
+{
+	static const char *const policies[] = { "none", "storage", "sq" };
+	const int storage_node = nvmev_vdev->config.storage_node;
+	unsigned int i;
+
+	NVMEV_INFO("NUMA: storage on node %d, %u node(s) online, policy %s\n", storage_node,
+		   num_online_nodes(), policies[nvmev_vdev->config.numa_policy]);
+
+	for (i = 0; i < nvmev_vdev->config.nr_dispatchers; i++) {
+		unsigned int cpu = nvmev_vdev->config.cpu_nr_dispatchers[i];
+
+		if (cpu != -1)
+			NVMEV_INFO("NUMA: dispatcher %u on cpu %u, node %d\n", i, cpu,
+				   cpu_to_node(cpu));
+	}
+
+	for (i = 0; i < nvmev_vdev->config.nr_io_workers; i++) {
+		int node = __get_io_worker_node(i);
+
+		NVMEV_INFO("NUMA: %s on cpu %u, node %d%s\n", nvmev_vdev->io_workers[i].thread_name,
+			   nvmev_vdev->config.cpu_nr_io_workers[i], node,
+			   (storage_node != NUMA_NO_NODE && node != storage_node) ?
+				   " (remote to storage)" : "");
+	}
+}
+
 void NVMEV_IO_WORKER_INIT(struct nvmev_dev *nvmev_vdev)
 {
 	unsigned int i, worker_id;
 
+	BUILD_BUG_ON(!is_power_of_2(NR_MAX_PARALLEL_IO)); /* Ring slots are masked */
+
 	nvmev_vdev->io_workers =
 		kcalloc(nvmev_vdev->config.nr_io_workers, sizeof(struct nvmev_io_worker), GFP_KERNEL);
 	nvmev_vdev->io_worker_turn = 0;
 
 	for (worker_id = 0; worker_id < nvmev_vdev->config.nr_io_workers; worker_id++) {
 		struct nvmev_io_worker *worker = &nvmev_vdev->io_workers[worker_id];
+		/* Keep the entries and rings next to the CPU that walks them */
+		int node = __get_io_worker_node(worker_id);
 
 		worker->work_queue =
-			kzalloc(sizeof(struct nvmev_io_work) * NR_MAX_PARALLEL_IO, GFP_KERNEL);
-		for (i = 0; i < NR_MAX_PARALLEL_IO; i++) {
+			kzalloc_node(sizeof(struct nvmev_io_work) * NR_MAX_PARALLEL_IO, GFP_KERNEL, node);
+		for (i = 0; i < NR_MAX_PARALLEL_IO; i++)
 			worker->work_queue[i].next = i + 1;
-			worker->work_queue[i].prev = i - 1;
-		}
 		worker->work_queue[NR_MAX_PARALLEL_IO - 1].next = -1;
 		worker->id = worker_id;
 		worker->free_seq = 0;
-		worker->free_seq_end = NR_MAX_PARALLEL_IO - 1;
-		worker->io_seq = -1;
-		worker->io_seq_end = -1;
+		worker->sub_ring.slots =
+			kcalloc_node(NR_MAX_PARALLEL_IO, sizeof(unsigned int), GFP_KERNEL, node);
+		worker->done_ring.slots =
+			kcalloc_node(NR_MAX_PARALLEL_IO, sizeof(unsigned int), GFP_KERNEL, node);
+		worker->io_tree = RB_ROOT_CACHED;
 
 		snprintf(worker->thread_name, sizeof(worker->thread_name), "nvmev_io_worker_%d", worker_id);
 
-		worker->task_struct = kthread_create(nvmev_io_worker, worker, "%s", worker->thread_name);
+		worker->task_struct = kthread_create_on_node(nvmev_io_worker, worker, node, "%s",
+							     worker->thread_name);
 
 		kthread_bind(worker->task_struct, nvmev_vdev->config.cpu_nr_io_workers[worker_id]);
-		wake_up_process(worker->task_struct);
 	}
+
+	/* SQs created later are mapped again with the node of their memory */
+	for (i = 1; i <= NR_MAX_IO_QUEUE; i++)
+		NVMEV_IO_WORKER_MAP_SQ(i, NUMA_NO_NODE);
+
+	__report_numa_placement(nvmev_vdev);
+
+	for (worker_id = 0; worker_id < nvmev_vdev->config.nr_io_workers; worker_id++)
+		wake_up_process(nvmev_vdev->io_workers[worker_id].task_struct);
+}
+
+/*
+ * Microbenchmark of the work_queue ordering, triggered by writing "iobench"
+ * to /proc/nvmev/debug. For each queue depth a private worker is filled with
+ * that many requests, then each round completes the earliest request and
+ * inserts it back with a random target up to 1 ms ahead, as the worker does
+ * in steady state with mixed read/write latencies.
+ */
+#define IOBENCH_ROUNDS (100000)
+
+static unsigned int __iobench_pop(struct nvmev_io_worker *worker, unsigned long long *now)
+{
+	struct rb_node *node = rb_first_cached(&worker->io_tree);
+	struct nvmev_io_work *w = rb_entry(node, struct nvmev_io_work, rb);
+
+	rb_erase_cached(node, &worker->io_tree);
+	*now = w->nsecs_target;
+	return w - worker->work_queue;
+}
+
+static void __iobench_insert(struct nvmev_io_worker *worker, unsigned int entry,
+			     unsigned long long now)
+{
+	worker->work_queue[entry].nsecs_target = now + (get_random_u32() % 1000000);
+	__insert_req_sorted(entry, worker);
+}
+
+void NVMEV_IO_WORKER_BENCH(void)
+{
+	static const unsigned int depths[] = { 1, 16, 256, 1024, 4096, 16384 };
+	struct nvmev_io_worker *worker;
+	unsigned int d, i, entry;
+	unsigned long long t, now, insert_ns, pop_ns;
+
+	worker = kzalloc(sizeof(struct nvmev_io_worker), GFP_KERNEL);
+	if (!worker)
+		return;
+	worker->work_queue = vzalloc(sizeof(struct nvmev_io_work) * NR_MAX_PARALLEL_IO);
+	if (!worker->work_queue) {
+		kfree(worker);
+		return;
+	}
+
+	for (d = 0; d < ARRAY_SIZE(depths); d++) {
+		unsigned int depth = min_t(unsigned int, depths[d], NR_MAX_PARALLEL_IO);
+
+		worker->io_tree = RB_ROOT_CACHED;
+		now = 0;
+		for (i = 0; i < depth; i++)
+			__iobench_insert(worker, i, now);
+
+		insert_ns = pop_ns = 0;
+		for (i = 0; i < IOBENCH_ROUNDS; i++) {
+			t = local_clock();
+			entry = __iobench_pop(worker, &now);
+			pop_ns += local_clock() - t;
+
+			t = local_clock();
+			__iobench_insert(worker, entry, now);
+			insert_ns += local_clock() - t;
+		}
+
+		NVMEV_INFO("iobench: qd %5u insert %llu ns pop %llu ns\n", depth,
+			   insert_ns / IOBENCH_ROUNDS, pop_ns / IOBENCH_ROUNDS);
+	}
+
+	vfree(worker->work_queue);
+	kfree(worker);
 }
 
 void NVMEV_IO_WORKER_FINAL(struct nvmev_dev *nvmev_vdev)
@@ -780,6 +1072,8 @@ void NVMEV_IO_WORKER_FINAL(struct nvmev_dev *nvmev_vdev)
 		}
 
 		kfree(worker->work_queue);
+		kfree(worker->sub_ring.slots);
+		kfree(worker->done_ring.slots);
 	}
 
 	kfree(nvmev_vdev->io_workers);
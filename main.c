@@ -56,6 +56,9 @@
 
 struct nvmev_dev *nvmev_vdev = NULL;
 
+// Dispatchers walk sqes/cqes inside this; admin deletes wait it out before freeing
+DEFINE_SRCU(nvmev_queue_srcu);
+
 static unsigned long memmap_start = 0;
 static unsigned long memmap_size = 0;
 
@@ -71,6 +74,8 @@ static unsigned int nr_io_units = 8;
 static unsigned int io_unit_shift = 12;
 
 static char *cpus;
+static unsigned int nr_dispatchers = 1;
+static unsigned int numa_policy = NUMA_POLICY_NONE;
 static unsigned int debug = 0;
 
 int io_using_dma = false;
@@ -109,16 +114,25 @@ module_param(io_unit_shift, uint, 0444);
 MODULE_PARM_DESC(io_unit_shift, "Size of each I/O unit (2^)");
 module_param(cpus, charp, 0444);
 MODULE_PARM_DESC(cpus, "CPU list for process, completion(int.) threads, Seperated by Comma(,)");
+module_param(nr_dispatchers, uint, 0444);
+MODULE_PARM_DESC(nr_dispatchers, "Number of dispatcher threads taken from the head of cpus, each serving a share of the SQs");
+module_param(numa_policy, uint, 0444);
+MODULE_PARM_DESC(numa_policy, "Node preferred when assigning SQs to IO workers (0: none, 1: storage, 2: SQ memory)");
 module_param(debug, uint, 0644);
 
 // Returns true if an event is processed
-static bool nvmev_proc_dbs(void)
+static bool nvmev_proc_dbs(unsigned int id)
 {
+	const unsigned int nr_dispatchers = nvmev_vdev->config.nr_dispatchers;
 	int qid;
 	int dbs_idx;
 	int new_db;
 	int old_db;
 	bool updated = false;
+	int idx;
+
+	if (id != 0)
+		goto io_queues;
 
 	// Admin queue
 	new_db = nvmev_vdev->dbs[0];
@@ -134,8 +148,11 @@ static bool nvmev_proc_dbs(void)
 		updated = true;
 	}
 
-	// Submission queues
-	for (qid = 1; qid <= nvmev_vdev->nr_sq; qid++) {
+io_queues:
+	idx = srcu_read_lock(&nvmev_queue_srcu);
+
+	// Submission queues, (qid - 1) % nr_dispatchers == id
+	for (qid = 1 + id; qid <= nvmev_vdev->nr_sq; qid += nr_dispatchers) {
 		if (nvmev_vdev->sqes[qid] == NULL)
 			continue;
 		dbs_idx = qid * 2;
@@ -148,7 +165,7 @@ static bool nvmev_proc_dbs(void)
 	}
 
 	// Completion queues
-	for (qid = 1; qid <= nvmev_vdev->nr_cq; qid++) {
+	for (qid = 1 + id; qid <= nvmev_vdev->nr_cq; qid += nr_dispatchers) {
 		if (nvmev_vdev->cqes[qid] == NULL)
 			continue;
 		dbs_idx = qid * 2 + 1;
@@ -161,22 +178,79 @@ static bool nvmev_proc_dbs(void)
 		}
 	}
 
+	srcu_read_unlock(&nvmev_queue_srcu, idx);
+
 	return updated;
 }
 
+// Let namespaces finish the requests dispatcher @id deferred. Returns true while any is outstanding
+static bool nvmev_proc_pending(unsigned int id)
+{
+	bool busy = false;
+	int i;
+
+	for (i = 0; i < nvmev_vdev->nr_ns; i++) {
+		struct nvmev_ns *ns = &nvmev_vdev->ns[i];
+
+		if (!ns->proc_pending)
+			continue;
+
+		if (nvmev_vdev->config.nr_dispatchers > 1 && !ns->concurrent) {
+			mutex_lock(&ns->lock);
+			busy |= ns->proc_pending(ns, id);
+			mutex_unlock(&ns->lock);
+		} else {
+			busy |= ns->proc_pending(ns, id);
+		}
+	}
+
+	return busy;
+}
+
+// Give namespaces a chance to run background work when no doorbell was rung
+static void nvmev_proc_idle(void)
+{
+	int i;
+
+	for (i = 0; i < nvmev_vdev->nr_ns; i++) {
+		struct nvmev_ns *ns = &nvmev_vdev->ns[i];
+
+		if (!ns->proc_idle)
+			continue;
+
+		if (nvmev_vdev->config.nr_dispatchers > 1 && !ns->concurrent) {
+			mutex_lock(&ns->lock);
+			ns->proc_idle(ns);
+			mutex_unlock(&ns->lock);
+		} else {
+			ns->proc_idle(ns);
+		}
+	}
+}
+
+/*
+ * Dispatcher @id serves the I/O queues with (qid - 1) % nr_dispatchers == id,
+ * and finishes the requests it deferred. Dispatcher 0 additionally handles
+ * the BARs, the admin queue and idle-time background work of the namespaces.
+ */
 static int nvmev_dispatcher(void *data)
 {
-	static unsigned long last_dispatched_time = 0;
+	unsigned int id = (unsigned long)data;
+	unsigned int cpu = nvmev_vdev->config.cpu_nr_dispatchers[id];
+	unsigned long last_dispatched_time = 0;
 
-	NVMEV_INFO("nvmev_dispatcher started on cpu %d (node %d)\n",
-		   nvmev_vdev->config.cpu_nr_dispatcher,
-		   cpu_to_node(nvmev_vdev->config.cpu_nr_dispatcher));
+	NVMEV_INFO("nvmev_dispatcher %u started on cpu %d (node %d)\n", id, cpu,
+		   cpu_to_node(cpu));
 
 	while (!kthread_should_stop()) {
-		if (nvmev_proc_bars())
+		if (id == 0 && nvmev_proc_bars())
+			last_dispatched_time = jiffies;
+		if (nvmev_proc_pending(id))
 			last_dispatched_time = jiffies;
-		if (nvmev_proc_dbs())
+		if (nvmev_proc_dbs(id))
 			last_dispatched_time = jiffies;
+		else if (id == 0)
+			nvmev_proc_idle();
 
 		if (CONFIG_NVMEVIRT_IDLE_TIMEOUT != 0 &&
 		    time_after(jiffies, last_dispatched_time + (CONFIG_NVMEVIRT_IDLE_TIMEOUT * HZ)))
@@ -190,17 +264,36 @@ static int nvmev_dispatcher(void *data)
 
 static void NVMEV_DISPATCHER_INIT(struct nvmev_dev *nvmev_vdev)
 {
-	nvmev_vdev->nvmev_dispatcher = kthread_create(nvmev_dispatcher, NULL, "nvmev_dispatcher");
-	if (nvmev_vdev->config.cpu_nr_dispatcher != -1)
-		kthread_bind(nvmev_vdev->nvmev_dispatcher, nvmev_vdev->config.cpu_nr_dispatcher);
-	wake_up_process(nvmev_vdev->nvmev_dispatcher);
+	unsigned int i;
+
+	for (i = 0; i < nvmev_vdev->config.nr_dispatchers; i++) {
+		struct task_struct *task;
+		unsigned int cpu = nvmev_vdev->config.cpu_nr_dispatchers[i];
+
+		int node = (cpu != -1) ? cpu_to_node(cpu) : NUMA_NO_NODE;
+
+		if (i == 0)
+			task = kthread_create_on_node(nvmev_dispatcher, (void *)0UL, node,
+						      "nvmev_dispatcher");
+		else
+			task = kthread_create_on_node(nvmev_dispatcher, (void *)(unsigned long)i, node,
+						      "nvmev_dispatcher_%u", i);
+		if (cpu != -1)
+			kthread_bind(task, cpu);
+		nvmev_vdev->nvmev_dispatchers[i] = task;
+		wake_up_process(task);
+	}
 }
 
 static void NVMEV_DISPATCHER_FINAL(struct nvmev_dev *nvmev_vdev)
 {
-	if (!IS_ERR_OR_NULL(nvmev_vdev->nvmev_dispatcher)) {
-		kthread_stop(nvmev_vdev->nvmev_dispatcher);
-		nvmev_vdev->nvmev_dispatcher = NULL;
+	unsigned int i;
+
+	for (i = 0; i < nvmev_vdev->config.nr_dispatchers; i++) {
+		if (!IS_ERR_OR_NULL(nvmev_vdev->nvmev_dispatchers[i])) {
+			kthread_stop(nvmev_vdev->nvmev_dispatchers[i]);
+			nvmev_vdev->nvmev_dispatchers[i] = NULL;
+		}
 	}
 }
 
@@ -341,6 +434,15 @@ static int __proc_file_read(struct seq_file *m, void *data)
 		}
 		seq_printf(m, "total: %u %u %u %llu\n", nr_in_flight, nr_dispatch, nr_dispatched,
 			   total_io);
+
+		/* Completion entries and interrupts per CQ, to see the effect of coalescing */
+		for (i = 1; i <= nvmev_vdev->nr_cq; i++) {
+			struct nvmev_completion_queue *cq = nvmev_vdev->cqes[i];
+			if (!cq)
+				continue;
+
+			seq_printf(m, "cq %2d: %llu %llu\n", i, cq->nr_cqes, cq->nr_irqs);
+		}
 	} else if (strcmp(filename, "debug") == 0) {
 		/* Left for later use */
 	}
@@ -392,7 +494,8 @@ static ssize_t __proc_file_write(struct file *file, const char __user *buf, size
 			memset(&sq->stat, 0x00, sizeof(sq->stat));
 		}
 	} else if (!strcmp(filename, "debug")) {
-		/* Left for later use */
+		if (!strncmp(input, "iobench", 7))
+			NVMEV_IO_WORKER_BENCH();
 	}
 
 out:
@@ -448,7 +551,7 @@ static void NVMEV_STORAGE_INIT(struct nvmev_dev *nvmev_vdev)
 	nvmev_vdev->proc_io_units =
 		proc_create("io_units", 0664, nvmev_vdev->proc_root, &proc_file_fops);
 	nvmev_vdev->proc_stat = proc_create("stat", 0444, nvmev_vdev->proc_root, &proc_file_fops);
-	nvmev_vdev->proc_debug = proc_create("debug", 0444, nvmev_vdev->proc_root, &proc_file_fops);
+	nvmev_vdev->proc_debug = proc_create("debug", 0664, nvmev_vdev->proc_root, &proc_file_fops);
 }
 
 static void NVMEV_STORAGE_FINAL(struct nvmev_dev *nvmev_vdev)
@@ -470,7 +573,6 @@ static void NVMEV_STORAGE_FINAL(struct nvmev_dev *nvmev_vdev)
 
 static bool __load_configs(struct nvmev_config *config)
 {
-	bool first = true;
 	unsigned int cpu_nr;
 	char *cpu;
 
@@ -487,6 +589,7 @@ static bool __load_configs(struct nvmev_config *config)
 	// storage space starts from 1M offset
 	config->storage_start = memmap_start + MB(1);
 	config->storage_size = memmap_size - MB(1);
+	config->storage_node = nvmev_phys_to_node(config->storage_start);
 
 	config->read_time = read_time;
 	config->read_delay = read_delay;
@@ -498,19 +601,58 @@ static bool __load_configs(struct nvmev_config *config)
 	config->io_unit_shift = io_unit_shift;
 
 	config->nr_io_workers = 0;
+	config->nr_dispatchers = 0;
 	config->cpu_nr_dispatcher = -1;
 
+	nr_dispatchers = clamp_t(unsigned int, nr_dispatchers, 1, NR_MAX_DISPATCHERS);
 	while ((cpu = strsep(&cpus, ",")) != NULL) {
 		cpu_nr = (unsigned int)simple_strtol(cpu, NULL, 10);
-		if (first) {
-			config->cpu_nr_dispatcher = cpu_nr;
+		if (config->nr_dispatchers < nr_dispatchers) {
+			config->cpu_nr_dispatchers[config->nr_dispatchers] = cpu_nr;
+			config->nr_dispatchers++;
 		} else {
 			config->cpu_nr_io_workers[config->nr_io_workers] = cpu_nr;
 			config->nr_io_workers++;
 		}
-		first = false;
 	}
 
+	if (config->nr_dispatchers == 0) {
+		config->cpu_nr_dispatchers[0] = -1;
+		config->nr_dispatchers = 1;
+	}
+	/* The first dispatcher's clock is the time base of the whole device */
+	config->cpu_nr_dispatcher = config->cpu_nr_dispatchers[0];
+
+	/*
+	 * Each IO worker must be fed by a single dispatcher, as its work_queue has
+	 * a single producer. Workers are picked by (sqid - 1) % nr_io_workers, so
+	 * this holds when nr_dispatchers divides nr_io_workers.
+	 */
+	if (config->nr_dispatchers > 1) {
+#ifndef CONFIG_NVMEV_IO_WORKER_BY_SQ
+		NVMEV_ERROR("Multiple dispatchers need CONFIG_NVMEV_IO_WORKER_BY_SQ\n");
+		return false;
+#endif
+		if (config->nr_io_workers % config->nr_dispatchers) {
+			NVMEV_ERROR("nr_io_workers %u is not a multiple of nr_dispatchers %u\n",
+				    config->nr_io_workers, config->nr_dispatchers);
+			return false;
+		}
+	}
+
+	config->numa_policy = numa_policy;
+	if (config->numa_policy > NUMA_POLICY_SQ) {
+		NVMEV_ERROR("Invalid numa_policy %u\n", numa_policy);
+		return false;
+	}
+#ifndef CONFIG_NVMEV_IO_WORKER_BY_SQ
+	/* Requests are spread over all workers in turn, whatever SQ they come from */
+	if (config->numa_policy != NUMA_POLICY_NONE) {
+		NVMEV_INFO("numa_policy needs CONFIG_NVMEV_IO_WORKER_BY_SQ, ignored\n");
+		config->numa_policy = NUMA_POLICY_NONE;
+	}
+#endif
+
 	return true;
 }
 
@@ -523,7 +665,7 @@ static void NVMEV_NAMESPACE_INIT(struct nvmev_dev *nvmev_vdev)
 	int i;
 	unsigned long long size;
 
-	struct nvmev_ns *ns = kmalloc(sizeof(struct nvmev_ns) * nr_ns, GFP_KERNEL);
+	struct nvmev_ns *ns = kcalloc(nr_ns, sizeof(struct nvmev_ns), GFP_KERNEL);
 
 	for (i = 0; i < nr_ns; i++) {
 		if (NS_CAPACITY(i) == 0)
@@ -542,6 +684,8 @@ static void NVMEV_NAMESPACE_INIT(struct nvmev_dev *nvmev_vdev)
 		else
 			BUG_ON(1);
 
+		mutex_init(&ns[i].lock);
+
 		remaining_capacity -= size;
 		ns_addr += size;
 		NVMEV_INFO("ns %d/%d: size %lld MiB\n", i, nr_ns, BYTE_TO_MB(ns[i].size));
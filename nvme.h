@@ -143,6 +143,7 @@ enum {
 	NVME_CTRL_ONCS_COMPARE = 1 << 0,
 	NVME_CTRL_ONCS_WRITE_UNCORRECTABLE = 1 << 1,
 	NVME_CTRL_ONCS_DSM = 1 << 2,
+	NVME_CTRL_ONCS_WRITE_ZEROES = 1 << 3,
 	NVME_CTRL_VWC_PRESENT = 1 << 0,
 };
 
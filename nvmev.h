@@ -5,6 +5,8 @@
 
 #include <linux/pci.h>
 #include <linux/msi.h>
+#include <linux/rbtree.h>
+#include <linux/srcu.h>
 #include <asm/apic.h>
 
 #include "nvme.h" // NVMe 프로토콜 표준 정의 헤더
@@ -167,6 +169,12 @@ struct nvmev_completion_queue {
     int cq_head;        // 큐의 Head (호스트가 읽은 위치)
     int cq_tail;        // 큐의 Tail (디바이스가 쓴 위치)
 
+    // 인터럽트 병합(Interrupt Coalescing) 상태: entry_lock으로 보호
+    unsigned int nr_pending_irqs;             // 마지막 인터럽트 이후 쌓인 완료 엔트리 수
+    unsigned long long nsecs_first_pending;   // 그 중 첫 엔트리를 기록한 시각
+    unsigned long long nr_cqes;               // 기록한 완료 엔트리 누적 수
+    unsigned long long nr_irqs;               // 발생시킨 인터럽트 누적 수
+
     struct nvme_completion __iomem **cq; // 실제 완료 메시지 저장소
     void *mapped;
 };
@@ -202,6 +210,16 @@ struct nvmev_admin_queue {
 /* 장치 설정 및 작업자(Worker) 구조체                      */
 /* ======================================================== */
 
+// 디스패처 스레드 최대 개수 (nr_dispatchers 모듈 파라미터)
+#define NR_MAX_DISPATCHERS (8)
+
+// SQ를 맡을 IO 워커를 고를 때 선호하는 NUMA 노드 (numa_policy 모듈 파라미터)
+enum {
+    NUMA_POLICY_NONE = 0,    // (sqid - 1) % nr_io_workers 그대로
+    NUMA_POLICY_STORAGE = 1, // 스토리지 영역이 있는 노드의 워커
+    NUMA_POLICY_SQ = 2,      // SQ 메모리(호스트 제출 측)가 있는 노드의 워커
+};
+
 /**
  * @brief 가상 NVMe 장치의 하드웨어/성능 설정값
  * DRAM 시뮬레이션을 위한 주소 범위 및 타이밍 파라미터 정의
@@ -212,8 +230,12 @@ struct nvmev_config {
 
     unsigned long storage_start; // 가상 스토리지 시작 주소
     unsigned long storage_size;  // 가상 스토리지 크기
+    int storage_node;            // 스토리지 영역이 속한 NUMA 노드 (모르면 NUMA_NO_NODE)
+    unsigned int numa_policy;    // NUMA_POLICY_*
 
-    unsigned int cpu_nr_dispatcher; // 디스패처가 실행될 CPU 코어
+    unsigned int cpu_nr_dispatcher; // 디스패처가 실행될 CPU 코어 (시뮬레이션 시계 기준)
+    unsigned int nr_dispatchers;    // 디스패처 스레드 개수 (SQ를 나눠 맡음)
+    unsigned int cpu_nr_dispatchers[NR_MAX_DISPATCHERS]; // 각 디스패처가 바인딩될 CPU 코어
     unsigned int nr_io_workers;     // IO 워커 스레드 개수
     unsigned int cpu_nr_io_workers[32]; // 각 워커가 바인딩될 CPU 코어
 
@@ -260,7 +282,19 @@ struct nvmev_io_work {
     void *write_buffer;  // 쓰기 버퍼 포인터
     size_t buffs_to_release; // 해제할 버퍼 크기
 
-    unsigned int next, prev; // 연결 리스트 링크 (작업 큐 관리용)
+    unsigned int next;   // 빈 슬롯 스택 링크 (디스패처 전용)
+    struct rb_node rb;   // 완료 목표 시각 순 정렬 트리 노드 (워커 전용)
+};
+
+/**
+ * @brief 디스패처와 워커 사이의 단일 생산자/단일 소비자 링
+ * 작업 인덱스만 주고받는다. 전체 작업 수가 NR_MAX_PARALLEL_IO이므로 넘치지 않는다.
+ * head(소비자)와 tail(생산자)은 서로 다른 캐시 라인에 둔다.
+ */
+struct nvmev_io_ring {
+    unsigned int head ____cacheline_aligned_in_smp; // 소비자만 갱신
+    unsigned int tail ____cacheline_aligned_in_smp; // 생산자만 갱신
+    unsigned int *slots ____cacheline_aligned_in_smp;
 };
 
 /**
@@ -270,13 +304,14 @@ struct nvmev_io_work {
 struct nvmev_io_worker {
     struct nvmev_io_work *work_queue; // 이 워커가 처리할 작업 큐
 
-    // 작업 큐 관리를 위한 인덱스들 (Ring Buffer 형태)
-    unsigned int free_seq;      /* 빈 슬롯 헤드 */
-    unsigned int free_seq_end;  /* 빈 슬롯 테일 */
-    unsigned int io_seq;        /* 처리 대기 중인 IO 헤드 */
-    unsigned int io_seq_end;    /* 처리 대기 중인 IO 테일 */
-
-    unsigned long long latest_nsecs; // 마지막 작업 시간
+    /*
+     * 작업 슬롯의 소유권은 링으로만 넘긴다: 디스패처가 빈 슬롯을 채워 sub_ring에 넣으면
+     * 워커가 정렬 트리에 넣어 완료 시각에 처리하고, done_ring으로 돌려준다.
+     */
+    unsigned int free_seq;            /* 빈 슬롯 스택 헤드 (디스패처 전용) */
+    struct nvmev_io_ring sub_ring;    /* 디스패처 -> 워커: 새 작업 */
+    struct nvmev_io_ring done_ring;   /* 워커 -> 디스패처: 완료된 작업 */
+    struct rb_root_cached io_tree;    /* 완료 목표 시각 순 정렬 트리 (워커 전용) */
 
     unsigned int id;                // 워커 ID
     struct task_struct *task_struct; // 커널 스레드 구조체 포인터
@@ -304,12 +339,18 @@ struct nvmev_dev {
     struct pci_dev *pdev; // 리눅스 커널의 PCI 장치 구조체
 
     struct nvmev_config config; // 장치 설정 정보
-    struct task_struct *nvmev_dispatcher; // IO 분배자 스레드
+    struct task_struct *nvmev_dispatchers[NR_MAX_DISPATCHERS]; // IO 분배자 스레드들
 
     void *storage_mapped; // 실제 스토리지 메모리 매핑
 
     struct nvmev_io_worker *io_workers; // 워커 스레드 배열
     unsigned int io_worker_turn;        // 라운드 로빈 분배용 인덱스
+    unsigned int sq_io_workers[NR_MAX_IO_QUEUE + 1]; // SQ별 담당 워커 (CONFIG_NVMEV_IO_WORKER_BY_SQ)
+
+    // Set Features로 설정되는 인터럽트 병합 파라미터
+    u8 irq_coalesce_thr;  // Aggregation Threshold (0-based 완료 엔트리 수)
+    u8 irq_coalesce_time; // Aggregation Time (100us 단위)
+    bool irq_coalesce_disabled[NR_MAX_IO_QUEUE + 1]; // 벡터별 Coalescing Disable (IRQ_CONFIG)
 
     void __iomem *msix_table; // MSI-X 테이블 (인터럽트 벡터)
 
@@ -355,6 +396,8 @@ struct nvmev_dev {
 struct nvmev_request {
     struct nvme_command *cmd; // NVMe 명령
     uint32_t sq_id;           // SQ ID
+    uint32_t sq_entry;        // SQ 내 인덱스 (완료를 미룰 때 필요)
+    uint32_t disp_id;         // 요청을 처리하는 디스패처 (SQ 담당)
     uint64_t nsecs_start;     // 시작 시간
 };
 
@@ -362,6 +405,7 @@ struct nvmev_request {
 struct nvmev_result {
     uint32_t status;          // 성공/실패 상태
     uint64_t nsecs_target;    // 시뮬레이션 된 완료 시간
+    bool deferred;            // 결과를 나중에 nvmev_complete_deferred()로 넘김 (proc_pending 필요)
 };
 
 /**
@@ -382,6 +426,23 @@ struct nvmev_ns {
     bool (*proc_io_cmd)(struct nvmev_ns *ns, struct nvmev_request *req,
                 struct nvmev_result *ret);
 
+    /* 디스패처가 처리할 doorbell이 없을 때 호출 (백그라운드 GC 등, 선택 사항) */
+    void (*proc_idle)(struct nvmev_ns *ns);
+
+    /*
+     * 디스패처 루프마다 호출: 디스패처 @id가 결과를 미룬(deferred) 요청을 마무리한다 (선택 사항).
+     * 아직 끝나지 않은 요청이 있으면 true를 반환해 디스패처가 잠들지 않게 한다.
+     */
+    bool (*proc_pending)(struct nvmev_ns *ns, unsigned int id);
+
+    /*
+     * 디스패처가 여럿이면 FTL 처리(proc_io_cmd, proc_idle, proc_pending)를 직렬화.
+     * FTL이 잠들 수 있고(kmalloc, memremap) GC가 오래 걸리므로 mutex를 쓴다.
+     * FTL이 스스로 보호하면(concurrent) 잡지 않는다.
+     */
+    struct mutex lock;
+    bool concurrent;
+
     /* 특정 명령어 셋(CSS) 식별 및 처리 함수 */
     bool (*identify_io_cmd)(struct nvmev_ns *ns, struct nvme_command cmd);
     unsigned int (*perform_io_cmd)(struct nvmev_ns *ns, struct nvme_command *cmd,
@@ -392,6 +453,7 @@ struct nvmev_ns {
 
 // 가상 장치 초기화 및 종료
 extern struct nvmev_dev *nvmev_vdev;
+extern struct srcu_struct nvmev_queue_srcu; // 디스패처의 IO 큐 순회 구간 (큐 삭제 시 대기)
 struct nvmev_dev *VDEV_INIT(void);
 void VDEV_FINALIZE(struct nvmev_dev *nvmev_vdev);
 
@@ -410,7 +472,12 @@ void schedule_internal_operation(int sqid, unsigned long long nsecs_target,
                 struct buffer *write_buffer, size_t buffs_to_release);
 void NVMEV_IO_WORKER_INIT(struct nvmev_dev *nvmev_vdev);
 void NVMEV_IO_WORKER_FINAL(struct nvmev_dev *nvmev_vdev);
+void NVMEV_IO_WORKER_BENCH(void);
+void NVMEV_IO_WORKER_MAP_SQ(int sqid, int node);
+int nvmev_phys_to_node(unsigned long paddr);
+void nvmev_complete_deferred(struct nvmev_request *req, struct nvmev_result *ret);
 int nvmev_proc_io_sq(int qid, int new_db, int old_db);
 void nvmev_proc_io_cq(int qid, int new_db, int old_db);
+size_t nvmev_copy_from_prp(u64 prp1, u64 prp2, void *buf, size_t len);
 
 #endif /* _LIB_NVMEV_H */
\ No newline at end of file
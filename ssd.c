@@ -2,10 +2,61 @@
 
 #include <linux/ktime.h>
 #include <linux/sched/clock.h>
+#include <linux/moduleparam.h>
 
 #include "nvmev.h"
 #include "ssd.h"
 
+// Program/Erase Suspend 설정 (기본값은 ssd_config.h)
+static int suspend_lat_ns = NAND_SUSPEND_LATENCY;
+static int resume_lat_ns = NAND_RESUME_LATENCY;
+static int max_suspends = NAND_MAX_SUSPENDS;
+
+module_param(suspend_lat_ns, int, 0444);
+MODULE_PARM_DESC(suspend_lat_ns, "Overhead in nsec to suspend a GC program/erase for a user read");
+module_param(resume_lat_ns, int, 0444);
+MODULE_PARM_DESC(resume_lat_ns, "Overhead in nsec to resume a suspended program/erase");
+module_param(max_suspends, int, 0444);
+MODULE_PARM_DESC(max_suspends, "Max suspends per program/erase (0 disables suspend)");
+
+// 지우기 시간 = blk_er_lat * (100 + min(erase_cnt / step * pcent, max_pcent)) / 100
+static int erase_wear_step = NAND_ERASE_WEAR_STEP;
+static int erase_wear_pcent = NAND_ERASE_WEAR_PCENT;
+static int erase_wear_max_pcent = NAND_ERASE_WEAR_MAX_PCENT;
+
+module_param(erase_wear_step, int, 0444);
+MODULE_PARM_DESC(erase_wear_step, "P/E cycles per erase latency step (0 disables wear-dependent erase latency)");
+module_param(erase_wear_pcent, int, 0444);
+MODULE_PARM_DESC(erase_wear_pcent, "Erase latency increase per step (percent)");
+module_param(erase_wear_max_pcent, int, 0444);
+MODULE_PARM_DESC(erase_wear_max_pcent, "Maximum erase latency increase (percent)");
+
+// Read-retry 테이블: 블록 P/E 횟수와 데이터 나이가 문턱을 하나 넘을 때마다 재시도 1회
+static int read_retry_pe[READ_RETRY_LEVELS] = NAND_READ_RETRY_PE;
+static int nr_read_retry_pe = NAND_READ_RETRY_NR_PE;
+static int read_retry_age[READ_RETRY_LEVELS] = NAND_READ_RETRY_AGE;
+static int nr_read_retry_age = NAND_READ_RETRY_NR_AGE;
+static int read_retry_age_scale = 1;
+static int read_retry_ecc_ns = NAND_READ_RETRY_ECC_LATENCY;
+static int read_retry_max = NAND_READ_RETRY_MAX;
+
+module_param_array(read_retry_pe, int, &nr_read_retry_pe, 0444);
+MODULE_PARM_DESC(read_retry_pe, "P/E cycle thresholds, each adding one read retry (ascending)");
+module_param_array(read_retry_age, int, &nr_read_retry_age, 0444);
+MODULE_PARM_DESC(read_retry_age, "Data age thresholds in seconds, each adding one read retry (ascending)");
+module_param(read_retry_age_scale, int, 0444);
+MODULE_PARM_DESC(read_retry_age_scale, "Simulated seconds of data age per elapsed second");
+module_param(read_retry_ecc_ns, int, 0444);
+MODULE_PARM_DESC(read_retry_ecc_ns, "ECC decode latency in nsec added by each read retry");
+module_param(read_retry_max, int, 0444);
+MODULE_PARM_DESC(read_retry_max, "Max retries per read (0 disables read retry)");
+
+// LUN 명령 스케줄러 (LUN_SCHED_*)
+static int lun_sched = LUN_SCHED_FIFO;
+
+module_param(lun_sched, int, 0444);
+MODULE_PARM_DESC(lun_sched, "Per-LUN command scheduler (0: FIFO, 1: read-first, 2: GC-deferred)");
+
 // 현재 CPU의 시계(Clock)를 가져오는 헬퍼 함수
 // 시뮬레이션의 기준 시간이 됩니다.
 static inline uint64_t __get_ioclock(struct ssd *ssd)
@@ -130,7 +181,8 @@ void ssd_init_params(struct ssdparams *spp, uint64_t capacity, uint32_t nparts)
     spp->slc_pgs_per_oneshotpg = SLC_ONESHOT_PAGE_SIZE / (spp->pgsz);
     //16키로바이트를 4키로바이트로 나눳으니 SLC 값은 역시나 4일것이며 이것은 slc 원샷 페이지 양
     spp->oneshotpgs_per_blk = DIV_ROUND_UP(blk_size, ONESHOT_PAGE_SIZE);
-    spp->slc_oneshotpgs_per_blk = DIV_ROUND_UP(blk_size, SLC_ONESHOT_PAGE_SIZE);
+    // SLC 모드도 워드라인 수는 같고, 워드라인당 저장 비트만 1/3
+    spp->slc_oneshotpgs_per_blk = spp->oneshotpgs_per_blk;
 
     spp->pgs_per_flashpg = FLASH_PAGE_SIZE / (spp->pgsz); 
 
@@ -165,6 +217,24 @@ void ssd_init_params(struct ssdparams *spp, uint64_t capacity, uint32_t nparts)
     spp->slc_pg_wr_lat = NAND_PROG_LATENCY_SLC; // 쓰기 시간 (tPROG)
     spp->slc_blk_er_lat = NAND_ERASE_LATENCY_SLC; // 지우기 시간 (tBERS)
 
+    spp->erase_wear_step = max(erase_wear_step, 0);
+    spp->erase_wear_pcent = max(erase_wear_pcent, 0);
+    spp->erase_wear_max_pcent = max(erase_wear_max_pcent, 0);
+
+    spp->nr_read_retry_pe = clamp(nr_read_retry_pe, 0, READ_RETRY_LEVELS);
+    memcpy(spp->read_retry_pe, read_retry_pe, sizeof(spp->read_retry_pe));
+    spp->nr_read_retry_age = clamp(nr_read_retry_age, 0, READ_RETRY_LEVELS);
+    memcpy(spp->read_retry_age, read_retry_age, sizeof(spp->read_retry_age));
+    spp->read_retry_age_scale = max(read_retry_age_scale, 1);
+    spp->read_retry_ecc_lat = max(read_retry_ecc_ns, 0);
+    spp->read_retry_max = max(read_retry_max, 0);
+
+    spp->lun_sched = (lun_sched >= 0 && lun_sched < NR_LUN_SCHEDS) ? lun_sched : LUN_SCHED_FIFO;
+
+    spp->suspend_lat = suspend_lat_ns;
+    spp->resume_lat = resume_lat_ns;
+    spp->max_suspends = max(max_suspends, 0);
+
     // 펌웨어(F/W) 오버헤드 시뮬레이션 값
     spp->fw_4kb_rd_lat = FW_4KB_READ_LATENCY;
     spp->fw_rd_lat = FW_READ_LATENCY;
@@ -219,7 +289,7 @@ void ssd_init_params(struct ssdparams *spp, uint64_t capacity, uint32_t nparts)
     spp->tt_luns = spp->luns_per_ch * spp->nchs; // 전체 LUN 수
 
     /* 슈퍼블록(Line)은 모든 채널/LUN을 묶은 단위 */
-    spp->blks_per_line = spp->tt_luns; 
+    spp->blks_per_line = spp->tt_luns * spp->pls_per_lun; // 멀티 플레인: LUN의 모든 플레인 블록 포함
 
     spp->pgs_per_line = spp->blks_per_line * spp->pgs_per_blk;
     spp->slc_pgs_per_line = spp->blks_per_line * spp->slc_pgs_per_blk;
@@ -227,7 +297,7 @@ void ssd_init_params(struct ssdparams *spp, uint64_t capacity, uint32_t nparts)
     spp->secs_per_line = spp->pgs_per_line * spp->secs_per_pg;
     spp->slc_secs_per_line = spp->slc_pgs_per_line * spp->secs_per_pg;
     
-    spp->tt_lines = spp->blks_per_lun; // 라인 개수 = LUN당 블록 수
+    spp->tt_lines = spp->blks_per_pl; // 라인 개수 = 플레인당 블록 수 (라인 ID = 블록 번호)
     spp->slc_tt_lines = spp->tt_lines * SLC_PORTION / 100;
     spp->tlc_tt_lines = spp->tt_lines - spp->slc_tt_lines;
     check_params(spp);
@@ -283,6 +353,8 @@ static void ssd_init_nand_blk(struct nand_block *blk, struct ssdparams *spp)
     blk->vpc = 0; // Valid Page Count
     blk->erase_cnt = 0;
     blk->wp = 0; // Write Pointer (Sequential Write 가정)
+    blk->cell_mode = spp->cell_mode;
+    blk->prog_time = 0;
 }
 
 static void ssd_remove_nand_blk(struct nand_block *blk)
@@ -298,6 +370,7 @@ static void ssd_init_nand_plane(struct nand_plane *pl, struct ssdparams *spp)
 {
     int i;
     pl->nblks = spp->blks_per_pl;
+    pl->next_pln_avail_time = 0; // 플레인 단위 읽기(tR) 점유 시간
     // 블록 배열 할당
     pl->blk = kmalloc(sizeof(struct nand_block) * pl->nblks, GFP_KERNEL);
     for (i = 0; i < pl->nblks; i++) {
@@ -325,6 +398,9 @@ static void ssd_init_nand_lun(struct nand_lun *lun, struct ssdparams *spp)
     }
     lun->next_lun_avail_time = 0; // LUN이 사용 가능해지는 시간 (Busy 관리용)
     lun->busy = false;
+    memset(&lun->susp, 0, sizeof(lun->susp));
+    lun->q.len = 0;
+    lun->q.floor = 0;
 }
 
 static void ssd_remove_nand_lun(struct nand_lun *lun)
@@ -336,7 +412,7 @@ static void ssd_remove_nand_lun(struct nand_lun *lun)
 }
 
 // SSD 채널 초기화
-static void ssd_init_ch(struct ssd_channel *ch, struct ssdparams *spp)
+static int ssd_init_ch(struct ssd_channel *ch, struct ssdparams *spp)
 {
     int i;
     ch->nluns = spp->luns_per_ch;
@@ -348,15 +424,18 @@ static void ssd_init_ch(struct ssd_channel *ch, struct ssdparams *spp)
 
     // 채널 대역폭 모델 초기화 (전송 지연 시뮬레이션용)
     ch->perf_model = kmalloc(sizeof(struct channel_model), GFP_KERNEL);
-    chmodel_init(ch->perf_model, spp->ch_bandwidth);
+    if (!ch->perf_model || chmodel_init(ch->perf_model, spp->ch_bandwidth))
+        return -ENOMEM;
 
     /* 펌웨어 오버헤드 추가 */
     ch->perf_model->xfer_lat += (spp->fw_ch_xfer_lat * UNIT_XFER_SIZE / KB(4));
+    return 0;
 }
 
 static void ssd_remove_ch(struct ssd_channel *ch)
 {
     int i;
+    chmodel_exit(ch->perf_model);
     kfree(ch->perf_model);
     for (i = 0; i < ch->nluns; i++)
         ssd_remove_nand_lun(&ch->lun[i]);
@@ -364,19 +443,23 @@ static void ssd_remove_ch(struct ssd_channel *ch)
 }
 
 // PCIe 인터페이스 초기화
-static void ssd_init_pcie(struct ssd_pcie *pcie, struct ssdparams *spp)
+static int ssd_init_pcie(struct ssd_pcie *pcie, struct ssdparams *spp)
 {
+    spin_lock_init(&pcie->lock);
     pcie->perf_model = kmalloc(sizeof(struct channel_model), GFP_KERNEL);
-    chmodel_init(pcie->perf_model, spp->pcie_bandwidth); // PCIe 대역폭 설정
+    if (!pcie->perf_model || chmodel_init(pcie->perf_model, spp->pcie_bandwidth)) // PCIe 대역폭 설정
+        return -ENOMEM;
+    return 0;
 }
 
 static void ssd_remove_pcie(struct ssd_pcie *pcie)
 {
+    chmodel_exit(pcie->perf_model);
     kfree(pcie->perf_model);
 }
 
-// 메인 SSD 구조체 초기화 (진입점)
-void ssd_init(struct ssd *ssd, struct ssdparams *spp, uint32_t cpu_nr_dispatcher)
+// 메인 SSD 구조체 초기화 (진입점). 대역폭 모델 메모리를 못 잡으면 -ENOMEM
+int ssd_init(struct ssd *ssd, struct ssdparams *spp, uint32_t cpu_nr_dispatcher)
 {
     uint32_t i;
     /* 파라미터 복사 */
@@ -385,21 +468,35 @@ void ssd_init(struct ssd *ssd, struct ssdparams *spp, uint32_t cpu_nr_dispatcher
     /* 내부 아키텍처(채널 배열) 초기화 */
     ssd->ch = kmalloc(sizeof(struct ssd_channel) * spp->nchs, GFP_KERNEL); 
     for (i = 0; i < spp->nchs; i++) {
-        ssd_init_ch(&(ssd->ch[i]), spp);
+        if (ssd_init_ch(&(ssd->ch[i]), spp)) {
+            NVMEV_ERROR("Failed to initialize the bandwidth model of channel %u\n", i);
+            return -ENOMEM;
+        }
     }
 
     /* 시뮬레이션 시계 동기화를 위한 CPU 번호 설정 */
     ssd->cpu_nr_dispatcher = cpu_nr_dispatcher;
+    ssd->nr_suspends = 0;
+    ssd->nr_erases = 0;
+    ssd->erase_ns = 0;
+    ssd->nr_reads = 0;
+    ssd->nr_retried_reads = 0;
+    ssd->nr_read_retries = 0;
+    ssd->nr_reordered = 0;
+    ssd->reorder_delay_ns = 0;
 
     /* PCIe 모델 초기화 */
     ssd->pcie = kmalloc(sizeof(struct ssd_pcie), GFP_KERNEL);
-    ssd_init_pcie(ssd->pcie, spp);
+    if (!ssd->pcie || ssd_init_pcie(ssd->pcie, spp)) {
+        NVMEV_ERROR("Failed to initialize the PCIe bandwidth model\n");
+        return -ENOMEM;
+    }
 
     /* 쓰기 버퍼 초기화 */
     ssd->write_buffer = kmalloc(sizeof(struct buffer), GFP_KERNEL);
     buffer_init(ssd->write_buffer, spp->write_buffer_size);
 
-    return;
+    return 0;
 }
 
 void ssd_remove(struct ssd *ssd)
@@ -408,6 +505,7 @@ void ssd_remove(struct ssd *ssd)
 
     kfree(ssd->write_buffer);
     if (ssd->pcie) {
+        chmodel_exit(ssd->pcie->perf_model);
         kfree(ssd->pcie->perf_model);
         kfree(ssd->pcie);
     }
@@ -430,8 +528,15 @@ void ssd_remove(struct ssd *ssd)
 uint64_t ssd_advance_pcie(struct ssd *ssd, uint64_t request_time, uint64_t length)
 {
     struct channel_model *perf_model = ssd->pcie->perf_model;
+    uint64_t completed_time;
+
     // 대역폭 모델을 이용해 전송 완료 시각 계산
-    return chmodel_request(perf_model, request_time, length);
+    // (PCIe는 모든 파티션이 공유하므로 파티션 스레드끼리 직렬화)
+    spin_lock(&ssd->pcie->lock);
+    completed_time = chmodel_request(perf_model, request_time, length);
+    spin_unlock(&ssd->pcie->lock);
+
+    return completed_time;
 }
 
 /* 쓰기 버퍼 성능 모델
@@ -458,6 +563,314 @@ uint64_t ssd_advance_write_buffer(struct ssd *ssd, uint64_t request_time, uint64
 
 // [핵심] 낸드 플래시 동작 시뮬레이션
 // 명령(Read/Write/Erase)에 따라 실제 낸드 동작 시간과 채널 전송 시간을 계산
+/*
+ * 유저 읽기가 GC/MIG program/erase의 셀 동작 도중 도착하면 그 연산을 중단(suspend)하고
+ * 읽기를 먼저 처리한다. 중단이 가능하면 읽기의 낸드 시작 시각을 *nand_stime에 넣고 true.
+ */
+static bool ssd_suspend_for_read(struct ssd *ssd, struct nand_lun *lun, struct nand_cmd *ncmd,
+                                 uint64_t cmd_stime, uint64_t *nand_stime)
+{
+    struct ssdparams *spp = &ssd->sp;
+    struct nand_suspend *susp = &lun->susp;
+
+    if (ncmd->type != USER_IO || !susp->active)
+        return false;
+
+    // 중단 가능한 연산이 LUN의 마지막 연산이고, 그 셀 동작 도중에 도착한 읽기만 대상
+    if (lun->next_lun_avail_time != susp->op_etime ||
+        cmd_stime < susp->op_stime || cmd_stime >= susp->op_etime)
+        return false;
+
+    if (cmd_stime < susp->resume_time) {
+        // 이미 중단된 상태: 앞선 읽기 뒤에 이어서 처리 (추가 오버헤드 없음)
+        *nand_stime = max(cmd_stime, susp->read_etime);
+        return true;
+    }
+
+    if (susp->nr_suspends >= spp->max_suspends)
+        return false;
+
+    susp->remaining = susp->op_etime - cmd_stime;
+    susp->nr_suspends++;
+    ssd->nr_suspends++;
+    *nand_stime = cmd_stime + spp->suspend_lat;
+    return true;
+}
+
+// 중단 중 읽기가 끝나면 남은 셀 동작을 재개하고 LUN 사용 가능 시각을 뒤로 민다
+static void ssd_resume_after_read(struct ssdparams *spp, struct nand_lun *lun, uint64_t read_etime)
+{
+    struct nand_suspend *susp = &lun->susp;
+
+    susp->read_etime = read_etime;
+    susp->resume_time = read_etime + spp->resume_lat;
+    susp->op_etime = susp->resume_time + susp->remaining;
+    lun->next_lun_avail_time = susp->op_etime;
+}
+
+// 새로 스케줄된 program/erase가 중단 가능한지(GC/MIG) 기록
+static void ssd_track_suspendable(struct ssdparams *spp, struct nand_lun *lun,
+                                  struct nand_cmd *ncmd, uint64_t nand_stime, uint64_t nand_etime)
+{
+    struct nand_suspend *susp = &lun->susp;
+
+    susp->active = spp->max_suspends > 0 && (ncmd->type == GC_IO || ncmd->type == MIG_IO);
+    susp->op_stime = nand_stime;
+    susp->op_etime = nand_etime;
+    susp->resume_time = nand_stime;
+    susp->read_etime = nand_stime;
+    susp->nr_suspends = 0;
+}
+
+/*
+ * 블록의 셀 모드에 맞는 NAND 지연 시간
+ * pSLC 블록은 slc_* 값을, 그 외에는 장치 고유 셀 모드(spp->cell_mode)의 값을 쓴다.
+ */
+static inline bool blk_is_pslc(struct ssdparams *spp, struct nand_block *blk)
+{
+    return blk->cell_mode == CELL_MODE_SLC && spp->cell_mode != CELL_MODE_SLC;
+}
+
+static uint64_t ssd_read_lat(struct ssdparams *spp, struct nand_block *blk, uint32_t cell,
+                             uint64_t xfer_size)
+{
+    if (blk_is_pslc(spp, blk))
+        return (xfer_size == 4096) ? spp->slc_pg_4kb_rd_lat : spp->slc_pg_rd_lat;
+    return (xfer_size == 4096) ? spp->pg_4kb_rd_lat[cell] : spp->pg_rd_lat[cell];
+}
+
+static uint64_t ssd_prog_lat(struct ssdparams *spp, struct nand_block *blk)
+{
+    return blk_is_pslc(spp, blk) ? spp->slc_pg_wr_lat : spp->pg_wr_lat;
+}
+
+// 지우기 시간은 블록의 P/E 횟수에 따라 계단식으로 늘어난다 (erase_wear_*)
+static uint64_t ssd_erase_lat(struct ssdparams *spp, struct nand_block *blk)
+{
+    uint64_t lat = spp->blk_er_lat;
+    uint64_t wear = 0;
+
+    // SLC 지우기 시간이 설정되지 않았으면(0) 블록 고유 값 사용
+    if (blk_is_pslc(spp, blk) && spp->slc_blk_er_lat)
+        lat = spp->slc_blk_er_lat;
+
+    if (spp->erase_wear_step > 0) {
+        wear = (uint64_t)(blk->erase_cnt / spp->erase_wear_step) * spp->erase_wear_pcent;
+        wear = min(wear, (uint64_t)spp->erase_wear_max_pcent);
+    }
+    return lat * (100 + wear) / 100;
+}
+
+/*
+ * 읽기 재시도 횟수: P/E 문턱과 데이터 나이 문턱을 넘은 개수의 합 (read_retry_max로 제한)
+ * 데이터 나이는 블록을 지운 뒤 첫 프로그램부터 잰다 (블록에서 가장 오래된 데이터 기준).
+ */
+static uint32_t ssd_read_retries(struct ssdparams *spp, struct nand_block *blk, uint64_t now)
+{
+    uint64_t age_s = 0;
+    uint32_t retries = 0;
+    int i;
+
+    if (spp->read_retry_max == 0)
+        return 0;
+
+    for (i = 0; i < spp->nr_read_retry_pe; i++)
+        if (blk->erase_cnt >= spp->read_retry_pe[i])
+            retries++;
+
+    if (blk->prog_time && now > blk->prog_time)
+        age_s = (now - blk->prog_time) / 1000000 * spp->read_retry_age_scale / 1000;
+    for (i = 0; i < spp->nr_read_retry_age; i++)
+        if (age_s >= (uint64_t)spp->read_retry_age[i])
+            retries++;
+
+    return min(retries, (uint32_t)spp->read_retry_max);
+}
+
+/*
+ * 멀티 플레인 program은 LUN의 모든 플레인에서 같은 번호 블록을 대상으로 한다.
+ * prog_time은 FTL이 블록을 비울 때(mark_block_free) 0으로 돌린다.
+ */
+static void ssd_update_prog_time(struct nand_lun *lun, uint32_t blk, uint64_t t)
+{
+    int i;
+
+    for (i = 0; i < lun->npls; i++) {
+        struct nand_block *b = &lun->pl[i].blk[blk];
+
+        if (!b->prog_time)
+            b->prog_time = t;
+    }
+}
+
+// 블록별 지우기 횟수(erase_cnt) 합계와 최댓값
+void ssd_get_erase_stats(struct ssd *ssd, uint64_t *total, uint32_t *max_cnt)
+{
+    struct ssdparams *spp = &ssd->sp;
+    uint32_t ch, lun, pl, blk;
+
+    *total = 0;
+    *max_cnt = 0;
+    for (ch = 0; ch < spp->nchs; ch++)
+        for (lun = 0; lun < spp->luns_per_ch; lun++)
+            for (pl = 0; pl < spp->pls_per_lun; pl++)
+                for (blk = 0; blk < spp->blks_per_pl; blk++) {
+                    int cnt = ssd->ch[ch].lun[lun].pl[pl].blk[blk].erase_cnt;
+
+                    *total += cnt;
+                    *max_cnt = max(*max_cnt, (uint32_t)cnt);
+                }
+}
+
+// FTL이 블록(= 라인) 하나의 모드를 바꿀 때 호출: 모든 채널/LUN/플레인의 같은 번호 블록에 적용
+void ssd_set_blk_cell_mode(struct ssd *ssd, uint32_t blk, int cell_mode)
+{
+    struct ssdparams *spp = &ssd->sp;
+    uint32_t ch, lun, pl;
+
+    NVMEV_ASSERT(blk < spp->blks_per_pl);
+    for (ch = 0; ch < spp->nchs; ch++)
+        for (lun = 0; lun < spp->luns_per_ch; lun++)
+            for (pl = 0; pl < spp->pls_per_lun; pl++)
+                ssd->ch[ch].lun[lun].pl[pl].blk[blk].cell_mode = cell_mode;
+}
+
+/*
+ * 멀티 플레인 타이밍:
+ * - 읽기(tR)는 플레인별로 점유하므로 같은 LUN의 다른 플레인 읽기와 겹칠 수 있다
+ *   (next_pln_avail_time). 데이터 전송은 채널 모델이 직렬화한다.
+ * - 프로그램/지우기는 FTL이 LUN의 모든 플레인을 묶어 한 번에 내리므로 LUN 전체를 점유한다.
+ * LUN 전체를 점유하는 연산 뒤에는 모든 플레인의 사용 가능 시각을 LUN에 맞춘다.
+ */
+static void ssd_sync_planes(struct nand_lun *lun)
+{
+    int i;
+
+    for (i = 0; i < lun->npls; i++)
+        lun->pl[i].next_pln_avail_time = lun->next_lun_avail_time;
+}
+
+/*
+ * LUN 스케줄러: 새 연산이 큐에서 대기 중인(아직 시작하지 않은) 연산을 앞지를 수 있는지 결정
+ * op: 새 연산의 분류, queued: 대기 중인 연산의 분류 (LUN_OP_*)
+ *
+ * 앞지른 연산은 뒤로 밀리지만 그 완료 시각은 이미 호출자에게 돌려준 뒤다.
+ * 유저 연산의 완료 시각은 호스트 완료(또는 쓰기 버퍼 반납)에 쓰였으므로 밀 수 없고,
+ * 완료가 밖으로 보이지 않는 백그라운드(GC/MIG) 연산만 앞지를 수 있다.
+ */
+static bool sched_read_first(int op, int queued)
+{
+    return op == LUN_OP_USER_READ && queued == LUN_OP_BG;
+}
+
+static bool sched_gc_deferred(int op, int queued)
+{
+    return op != LUN_OP_BG && queued == LUN_OP_BG;
+}
+
+static const struct lun_scheduler {
+    const char *name;
+    bool (*may_bypass)(int op, int queued); // NULL: 앞지르기 없음 (FIFO)
+} lun_schedulers[NR_LUN_SCHEDS] = {
+    [LUN_SCHED_FIFO] = { "fifo", NULL },
+    [LUN_SCHED_READ_FIRST] = { "read-first", sched_read_first },
+    [LUN_SCHED_GC_DEFERRED] = { "gc-deferred", sched_gc_deferred },
+};
+
+const char *ssd_lun_sched_name(struct ssd *ssd)
+{
+    return lun_schedulers[ssd->sp.lun_sched].name;
+}
+
+static int lun_op_class(struct nand_cmd *ncmd)
+{
+    if (ncmd->type != USER_IO)
+        return LUN_OP_BG;
+    return ncmd->cmd == NAND_READ ? LUN_OP_USER_READ : LUN_OP_USER_WRITE;
+}
+
+/*
+ * 끝난 연산을 큐에서 정리한 뒤, 새 연산이 들어갈 위치를 뒤에서부터 찾는다.
+ * 이미 시작했거나 앞지를 수 없는 연산을 만나면 멈추고, 그 앞 연산들이 끝나는 시각을
+ * *barrier(새 연산의 시작 하한)로 돌려준다. 반환값이 q->len이면 앞지르기 없음.
+ */
+static int lun_q_find_slot(struct ssdparams *spp, struct nand_lun *lun, int cls, uint64_t t,
+                           uint64_t *barrier)
+{
+    const struct lun_scheduler *sched = &lun_schedulers[spp->lun_sched];
+    struct nand_lun_queue *q = &lun->q;
+    int i = 0, k;
+
+    while (i < q->len && q->ops[i].etime <= t)
+        i++;
+    if (i) {
+        memmove(q->ops, q->ops + i, (q->len - i) * sizeof(q->ops[0]));
+        q->len -= i;
+    }
+
+    k = q->len;
+    while (k > 0 && q->ops[k - 1].stime > t && q->ops[k - 1].cls == LUN_OP_BG &&
+           sched->may_bypass(cls, q->ops[k - 1].cls))
+        k--;
+
+    *barrier = max(t, q->floor);
+    for (i = 0; i < k; i++)
+        *barrier = max(*barrier, q->ops[i].etime);
+
+    return k;
+}
+
+/*
+ * 새 연산 [stime, etime)을 k 위치에 넣는다. 앞지른 연산들은 새 연산이 끝난 뒤로 밀고,
+ * LUN 사용 가능 시각과 (밀린 연산이 중단 가능한 연산이면) suspend 상태도 함께 민다.
+ */
+static void lun_q_insert(struct ssd *ssd, struct nand_lun *lun, int k, int cls, uint64_t stime,
+                         uint64_t etime)
+{
+    struct nand_lun_queue *q = &lun->q;
+    struct nand_suspend *susp = &lun->susp;
+    uint64_t first, delta;
+    int i;
+
+    if (k < q->len && etime > q->ops[k].stime) {
+        first = q->ops[k].stime;
+        delta = etime - first;
+        for (i = k; i < q->len; i++) {
+            q->ops[i].stime += delta;
+            q->ops[i].etime += delta;
+        }
+        if (susp->active && susp->op_stime >= first) {
+            susp->op_stime += delta;
+            susp->op_etime += delta;
+            susp->resume_time += delta;
+            susp->read_etime += delta;
+        }
+        lun->next_lun_avail_time += delta;
+        ssd_sync_planes(lun);
+
+        ssd->nr_reordered++;
+        ssd->reorder_delay_ns += delta * (q->len - k);
+    }
+
+    if (q->len == LUN_QUEUE_DEPTH) {
+        // 가장 오래된 연산을 빼고 floor로만 기억
+        q->floor = max(q->floor, q->ops[0].etime);
+        memmove(q->ops, q->ops + 1, (q->len - 1) * sizeof(q->ops[0]));
+        q->len--;
+        if (k == 0) {
+            q->floor = max(q->floor, etime);
+            return;
+        }
+        k--;
+    }
+
+    memmove(q->ops + k + 1, q->ops + k, (q->len - k) * sizeof(q->ops[0]));
+    q->ops[k].stime = stime;
+    q->ops[k].etime = etime;
+    q->ops[k].cls = cls;
+    q->len++;
+}
+
 uint64_t ssd_advance_nand(struct ssd *ssd, struct nand_cmd *ncmd)
 {
     int c = ncmd->cmd;
@@ -469,8 +882,15 @@ uint64_t ssd_advance_nand(struct ssd *ssd, struct nand_cmd *ncmd)
     struct ssdparams *spp;
     struct nand_lun *lun;
     struct ssd_channel *ch;
+    struct nand_plane *pl;
+    struct nand_block *blk;
     struct ppa *ppa = ncmd->ppa;
-    uint32_t cell;
+    uint32_t cell, retries;
+    uint64_t read_lat;
+    bool suspended;
+    bool sched, reorder = false;
+    int cls = 0, slot = 0;
+    uint64_t barrier = 0;
 
     // 디버그 로그
     NVMEV_DEBUG(
@@ -485,9 +905,19 @@ uint64_t ssd_advance_nand(struct ssd *ssd, struct nand_cmd *ncmd)
     spp = &ssd->sp;
     lun = get_lun(ssd, ppa); // 해당 LUN 포인터
     ch = get_ch(ssd, ppa);   // 해당 채널 포인터
+    pl = get_pl(ssd, ppa);     // 대상 플레인 (읽기 점유 단위)
+    blk = get_blk(ssd, ppa);   // 대상 블록 (셀 모드별 지연 시간 결정)
     cell = get_cell(ssd, ppa); // 셀 타입 (SLC/MLC 등)
     remaining = ncmd->xfer_size;
 
+    // FIFO가 아니면 큐에서 앞지를 위치를 찾는다 (reorder면 barrier부터 시작)
+    sched = spp->lun_sched != LUN_SCHED_FIFO && c != NAND_NOP;
+    if (sched) {
+        cls = lun_op_class(ncmd);
+        slot = lun_q_find_slot(spp, lun, cls, cmd_stime, &barrier);
+        reorder = slot < lun->q.len;
+    }
+
     switch (c) {
     case NAND_READ:
         // [읽기 동작 순서]
@@ -495,13 +925,22 @@ uint64_t ssd_advance_nand(struct ssd *ssd, struct nand_cmd *ncmd)
         // 2. 채널을 통해 컨트롤러로 데이터 전송 (tDMA)
 
         // LUN이 이전에 바빴다면, 끝난 시간부터 시작 (Serialization)
-        nand_stime = max(lun->next_lun_avail_time, cmd_stime);
-
-        // 낸드 읽기 시간 추가 (tR)
-        if (ncmd->xfer_size == 4096) {
-            nand_etime = nand_stime + spp->pg_4kb_rd_lat[cell];
-        } else {
-            nand_etime = nand_stime + spp->pg_rd_lat[cell];
+        // 단, GC/MIG program/erase 도중이면 중단하고 먼저 처리할 수 있음
+        // 스케줄러가 대기 중인 연산을 앞지르게 했으면 barrier부터 시작 (밀린 연산은 lun_q_insert()에서)
+        suspended = !reorder && ssd_suspend_for_read(ssd, lun, ncmd, cmd_stime, &nand_stime);
+        if (reorder)
+            nand_stime = barrier;
+        else if (!suspended)
+            nand_stime = max(pl->next_pln_avail_time, cmd_stime);
+
+        // 낸드 읽기 시간 추가 (tR), 마모/데이터 나이에 따라 재시도마다 tR + ECC 디코딩 반복
+        read_lat = ssd_read_lat(spp, blk, cell, ncmd->xfer_size);
+        retries = ssd_read_retries(spp, blk, nand_stime);
+        nand_etime = nand_stime + read_lat + retries * (read_lat + spp->read_retry_ecc_lat);
+        ssd->nr_reads++;
+        if (retries) {
+            ssd->nr_retried_reads++;
+            ssd->nr_read_retries += retries;
         }
 
         // 채널 전송 시작 (낸드 읽기가 끝나야 가능)
@@ -525,7 +964,18 @@ uint64_t ssd_advance_nand(struct ssd *ssd, struct nand_cmd *ncmd)
         }
 
         // LUN 사용 가능 시간 갱신
-        lun->next_lun_avail_time = chnl_etime;
+        if (suspended) {
+            ssd_resume_after_read(spp, lun, chnl_etime);
+            ssd_sync_planes(lun);
+            // 중단된 연산(큐의 마지막)이 늘어난 만큼 반영, 읽기는 그 구간 안에서 처리됨
+            if (sched && lun->q.len)
+                lun->q.ops[lun->q.len - 1].etime = lun->next_lun_avail_time;
+            sched = false;
+        } else if (!reorder) {
+            pl->next_pln_avail_time = chnl_etime;
+            lun->next_lun_avail_time = max(lun->next_lun_avail_time, chnl_etime);
+            lun->susp.active = false;
+        }
         break;
 
     case NAND_WRITE:
@@ -534,25 +984,36 @@ uint64_t ssd_advance_nand(struct ssd *ssd, struct nand_cmd *ncmd)
         // 2. Page Register에서 NAND Array로 프로그램 (tPROG)
 
         // 채널 전송부터 시작 (LUN Busy 여부 확인)
-        chnl_stime = max(lun->next_lun_avail_time, cmd_stime);
+        chnl_stime = reorder ? barrier : max(lun->next_lun_avail_time, cmd_stime);
 
         // 채널 전송 시간 계산
         chnl_etime = chmodel_request(ch->perf_model, chnl_stime, ncmd->xfer_size);
 
         // 낸드 프로그램 시작 (전송이 끝나야 가능)
         nand_stime = chnl_etime;
-        nand_etime = nand_stime + spp->pg_wr_lat; // tPROG 추가
+        nand_etime = nand_stime + ssd_prog_lat(spp, blk); // tPROG 추가
 
-        // LUN 사용 가능 시간 갱신
-        lun->next_lun_avail_time = nand_etime;
+        // LUN 사용 가능 시간 갱신 (멀티 플레인 프로그램: 모든 플레인 점유)
+        if (!reorder) {
+            lun->next_lun_avail_time = nand_etime;
+            ssd_sync_planes(lun);
+            ssd_track_suspendable(spp, lun, ncmd, nand_stime, nand_etime);
+        }
+        ssd_update_prog_time(lun, ppa->g.blk, nand_etime);
         completed_time = nand_etime;
         break;
 
     case NAND_ERASE:
         /* Erase: 데이터 전송 없음, 낸드 내부 동작만 수행 */
-        nand_stime = max(lun->next_lun_avail_time, cmd_stime);
-        nand_etime = nand_stime + spp->blk_er_lat; // tBERS 추가
-        lun->next_lun_avail_time = nand_etime;
+        nand_stime = reorder ? barrier : max(lun->next_lun_avail_time, cmd_stime);
+        nand_etime = nand_stime + ssd_erase_lat(spp, blk); // tBERS 추가 (마모 반영)
+        if (!reorder) {
+            lun->next_lun_avail_time = nand_etime;
+            ssd_sync_planes(lun);
+            ssd_track_suspendable(spp, lun, ncmd, nand_stime, nand_etime);
+        }
+        ssd->nr_erases++;
+        ssd->erase_ns += nand_etime - nand_stime;
         completed_time = nand_etime;
         break;
 
@@ -560,6 +1021,7 @@ uint64_t ssd_advance_nand(struct ssd *ssd, struct nand_cmd *ncmd)
         /* No Operation: 단순히 동기화를 위해 현재 LUN의 완료 시간을 반환 */
         nand_stime = max(lun->next_lun_avail_time, cmd_stime);
         lun->next_lun_avail_time = nand_stime;
+        ssd_sync_planes(lun);
         completed_time = nand_stime;
         break;
 
@@ -568,6 +1030,10 @@ uint64_t ssd_advance_nand(struct ssd *ssd, struct nand_cmd *ncmd)
         return 0;
     }
 
+    if (sched)
+        lun_q_insert(ssd, lun, slot, cls, (c == NAND_WRITE) ? chnl_stime : nand_stime,
+                     (c == NAND_READ) ? chnl_etime : nand_etime);
+
     return completed_time;
 }
 
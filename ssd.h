@@ -4,6 +4,7 @@
 #define _NVMEVIRT_SSD_H
 
 #include <linux/types.h>
+#include <linux/spinlock.h>
 #include "pqueue/pqueue.h"
 #include "ssd_config.h"
 #include "channel_model.h"
@@ -27,6 +28,9 @@
 #define INVALID_LPN (~(0ULL))
 #define UNMAPPED_PPA (~(0ULL))
 
+/* Read-retry 문턱 테이블의 최대 길이 */
+#define READ_RETRY_LEVELS (8)
+
 /* 낸드 플래시 명령 타입 */
 enum {
     NAND_READ = 0,
@@ -39,7 +43,7 @@ enum {
 enum {
     USER_IO = 0, // 호스트(사용자)가 보낸 요청 (처리 우선순위 높음)
     GC_IO = 1,   // 내부 GC가 생성한 요청 (Valid Page Copy 등)
-    MIG_IO = 2;
+    MIG_IO = 2,
 };
 
 /* 섹터 및 페이지 상태 */
@@ -118,6 +122,8 @@ struct nand_block {
     
     int erase_cnt; /* Erase Count: 지운 횟수 (수명/Wear-leveling 관리용) */
     int wp;        /* Write Pointer: 현재 쓰고 있는 페이지 위치 (순차 쓰기용) */
+    int cell_mode; /* 현재 프로그램 모드 (pSLC로 쓰는 블록은 CELL_MODE_SLC, 기본은 spp->cell_mode) */
+    uint64_t prog_time; /* 지운 뒤 첫 프로그램 완료 시각 (0: 비어 있음), 데이터 나이 계산용 */
 };
 
 /* 낸드 플레인 구조체 (블록의 집합) */
@@ -130,6 +136,50 @@ struct nand_plane {
 /* * @brief 낸드 LUN (Die) 구조체
  * 독립적으로 명령을 수행할 수 있는 최소 단위입니다.
  */
+/* Program/Erase Suspend 상태: LUN에 마지막으로 걸린 GC/MIG program/erase */
+struct nand_suspend {
+    bool active;          // 마지막 연산이 중단 가능한 program/erase인지
+    uint64_t op_stime;    // 셀 동작(tPROG/tBERS) 시작 시각
+    uint64_t op_etime;    // 셀 동작 종료 시각 (중단되면 뒤로 밀림)
+    uint64_t remaining;   // 중단 시점에 남아 있던 셀 동작 시간
+    uint64_t resume_time; // 중단된 연산이 재개되는 시각
+    uint64_t read_etime;  // 중단 중에 처리된 마지막 읽기의 종료 시각
+    uint32_t nr_suspends; // 이 연산이 중단된 횟수
+};
+
+/*
+ * LUN 명령 큐: 시간이 정해졌지만 아직 끝나지 않은 연산들 (시작 시각 순)
+ * FIFO가 아닌 스케줄러는 아직 시작하지 않은 GC/MIG 연산 앞에 새 연산을 끼워 넣고 뒤 연산들을 민다.
+ */
+#define LUN_QUEUE_DEPTH (32)
+
+/* 스케줄러가 보는 연산 분류 */
+enum {
+    LUN_OP_USER_READ = 0,
+    LUN_OP_USER_WRITE = 1,
+    LUN_OP_BG = 2, // GC/MIG 읽기/쓰기/지우기
+};
+
+/* LUN 스케줄러 정책 */
+enum {
+    LUN_SCHED_FIFO = 0,        // 제출 순서대로 (기존 동작)
+    LUN_SCHED_READ_FIRST = 1,  // 유저 읽기가 대기 중인 GC/MIG 연산을 앞지름
+    LUN_SCHED_GC_DEFERRED = 2, // 유저 읽기/쓰기가 대기 중인 GC/MIG 연산을 앞지름
+    NR_LUN_SCHEDS,
+};
+
+struct nand_lun_op {
+    uint64_t stime;
+    uint64_t etime;
+    int cls; // LUN_OP_*
+};
+
+struct nand_lun_queue {
+    struct nand_lun_op ops[LUN_QUEUE_DEPTH];
+    int len;
+    uint64_t floor; // 큐가 넘쳐 빠진 연산의 최대 종료 시각 (이보다 앞당길 수 없음)
+};
+
 struct nand_lun {
     struct nand_plane *pl;
     int npls;
@@ -139,6 +189,8 @@ struct nand_lun {
     uint64_t next_lun_avail_time; 
     bool busy;
     uint64_t gc_endtime;
+    struct nand_suspend susp; // Program/Erase Suspend 상태
+    struct nand_lun_queue q;  // LUN 명령 큐 (lun_sched가 FIFO가 아닐 때만 사용)
 };
 
 /* SSD 채널 구조체 (버스) */
@@ -154,6 +206,7 @@ struct ssd_channel {
 /* PCIe 인터페이스 구조체 */
 struct ssd_pcie {
     struct channel_model *perf_model; // PCIe 대역폭 모델
+    spinlock_t lock;                  // 파티션 스레드들이 공유하므로 보호 필요
 };
 
 /* 내부 낸드 명령 구조체 (시뮬레이터 전달용) */
@@ -228,6 +281,27 @@ struct ssdparams {
     int slc_pg_wr_lat;                     // 페이지 쓰기 시간 (tPROG)
     int slc_blk_er_lat;                    // 블록 지우기 시간 (tBERS)
 
+    /* 마모에 따른 지우기 시간 증가 곡선 */
+    int erase_wear_step;      // 이 P/E 횟수마다 한 단계 증가 (0: 비활성)
+    int erase_wear_pcent;     // 단계당 증가율 (%)
+    int erase_wear_max_pcent; // 최대 증가율 (%)
+
+    /* Read-retry (P/E 횟수, 데이터 나이 문턱을 넘을 때마다 재시도 1회) */
+    int read_retry_pe[READ_RETRY_LEVELS];  // P/E 문턱 (오름차순)
+    int nr_read_retry_pe;
+    int read_retry_age[READ_RETRY_LEVELS]; // 데이터 나이 문턱 (초, 오름차순)
+    int nr_read_retry_age;
+    int read_retry_age_scale; // 실제 1초를 몇 초로 볼지 (나이 가속)
+    int read_retry_ecc_lat;   // 재시도 1회당 ECC 디코딩 시간
+    int read_retry_max;       // 최대 재시도 횟수 (0: 비활성)
+
+    int lun_sched; // LUN 명령 스케줄러 (LUN_SCHED_*)
+
+    /* Program/Erase Suspend */
+    int suspend_lat;   // 중단 오버헤드
+    int resume_lat;    // 재개 오버헤드
+    int max_suspends;  // 연산당 최대 중단 횟수 (0: 비활성)
+
     /* 펌웨어(F/W) 오버헤드 시뮬레이션 값 */
     int fw_4kb_rd_lat; 
     int fw_rd_lat; 
@@ -291,6 +365,14 @@ struct ssd {
     struct ssd_pcie *pcie;  // PCIe 인터페이스
     struct buffer *write_buffer; // 쓰기 버퍼
     unsigned int cpu_nr_dispatcher; // 연결된 CPU 코어 번호
+    uint64_t nr_suspends; // 유저 읽기로 GC/MIG program/erase를 중단한 횟수
+    uint64_t nr_erases;   // 타이밍이 적용된 지우기 명령 수
+    uint64_t erase_ns;    // 지우기 명령에 걸린 시간 합 (ns)
+    uint64_t nr_reads;         // 타이밍이 적용된 읽기 명령 수
+    uint64_t nr_retried_reads; // 재시도가 필요했던 읽기 수
+    uint64_t nr_read_retries;  // 재시도 횟수 합
+    uint64_t nr_reordered;     // 대기 중인 연산을 앞질러 스케줄된 연산 수
+    uint64_t reorder_delay_ns; // 앞지르기로 뒤로 밀린 연산들의 지연 합 (ns)
 };
 
 /* * [Inline Helper Functions]
@@ -342,13 +424,16 @@ static inline uint32_t get_cell(struct ssd *ssd, struct ppa *ppa)
 
 /* 함수 원형 선언 (ssd.c 구현) */
 void ssd_init_params(struct ssdparams *spp, uint64_t capacity, uint32_t nparts);
-void ssd_init(struct ssd *ssd, struct ssdparams *spp, uint32_t cpu_nr_dispatcher);
+int ssd_init(struct ssd *ssd, struct ssdparams *spp, uint32_t cpu_nr_dispatcher);
 void ssd_remove(struct ssd *ssd);
 
 uint64_t ssd_advance_nand(struct ssd *ssd, struct nand_cmd *ncmd);
 uint64_t ssd_advance_pcie(struct ssd *ssd, uint64_t request_time, uint64_t length);
 uint64_t ssd_advance_write_buffer(struct ssd *ssd, uint64_t request_time, uint64_t length);
 uint64_t ssd_next_idle_time(struct ssd *ssd);
+void ssd_set_blk_cell_mode(struct ssd *ssd, uint32_t blk, int cell_mode);
+void ssd_get_erase_stats(struct ssd *ssd, uint64_t *total, uint32_t *max_cnt);
+const char *ssd_lun_sched_name(struct ssd *ssd);
 
 void buffer_init(struct buffer *buf, size_t size);
 uint32_t buffer_allocate(struct buffer *buf, size_t size);
@@ -163,7 +163,24 @@ static_assert((ONESHOT_PAGE_SIZE % FLASH_PAGE_SIZE) == 0);
 #define NAND_PROG_LATENCY (185000)
 // TLC Program latency (약 185us)
 
-#define NAND_ERASE_LATENCY (0)
+#define NAND_ERASE_LATENCY (3500000)
+// TLC Erase latency (약 3.5ms, 새 블록 기준)
+
+/* 마모에 따른 지우기 시간 증가: P/E NAND_ERASE_WEAR_STEP회마다 NAND_ERASE_WEAR_PCENT%씩, 최대 +MAX% */
+#define NAND_ERASE_WEAR_STEP (100)
+#define NAND_ERASE_WEAR_PCENT (5)
+#define NAND_ERASE_WEAR_MAX_PCENT (100)
+
+/*
+ * Read-retry: 블록의 P/E 횟수와 데이터 나이(프로그램 후 경과 초)가 문턱을 하나 넘을 때마다
+ * 재시도 1회 (tR 재수행 + ECC 디코딩). 문턱은 오름차순, 최대 READ_RETRY_LEVELS개.
+ */
+#define NAND_READ_RETRY_PE { 1000, 2000, 3000 }
+#define NAND_READ_RETRY_NR_PE (3)
+#define NAND_READ_RETRY_AGE { 86400, 604800, 2592000 } // 1일, 1주, 30일
+#define NAND_READ_RETRY_NR_AGE (3)
+#define NAND_READ_RETRY_ECC_LATENCY (10000) // 재시도 1회당 ECC 디코딩 시간
+#define NAND_READ_RETRY_MAX (6)             // 읽기 한 번의 최대 재시도 횟수 (0: 비활성)
 
 /* ========================================================= */
 /* 6. SLC Buffer (Pseudo-SLC) 설정 */
@@ -176,8 +193,8 @@ static_assert((ONESHOT_PAGE_SIZE % FLASH_PAGE_SIZE) == 0);
 // Plane당 SLC 블록 수 계산
 // (실제 적용은 FTL에서 분리 로직 필요)
 
-#define SLC_ONESHOT_PAGE_SIZE KB(FLASH_PAGE_SIZE)
-// SLC 모드에서의 프로그램 단위
+#define SLC_ONESHOT_PAGE_SIZE (FLASH_PAGE_SIZE)
+// SLC 모드에서의 프로그램 단위 (워드라인당 플래시 페이지 1개)
 // TLC(48KB)보다 작은 단위로 빠르게 기록
 
 #define NAND_4KB_READ_LATENCY_SLC (16254)
@@ -187,6 +204,11 @@ static_assert((ONESHOT_PAGE_SIZE % FLASH_PAGE_SIZE) == 0);
 
 #define NAND_ERASE_LATENCY_SLC (0)
 
+/* Program/Erase Suspend (GC/MIG 연산 도중 유저 읽기 우선 처리) */
+#define NAND_SUSPEND_LATENCY (20000) // 진행 중인 program/erase를 멈추는 데 걸리는 시간 (tPSL/tESL)
+#define NAND_RESUME_LATENCY (5000)   // 읽기 후 연산을 재개하는 오버헤드
+#define NAND_MAX_SUSPENDS (4)        // 연산 하나가 중단될 수 있는 최대 횟수 (0: 비활성)
+
 /* ========================================================= */
 /* 7. Firmware / Write Buffer 모델 */
 /* ========================================================= */
@@ -351,6 +373,27 @@ static_assert((ZONE_SIZE % DIES_PER_ZONE) == 0);
 #endif
 ///////////////////////////////////////////////////////////////////////////
 
+#ifndef NAND_SUSPEND_LATENCY
+#define NAND_SUSPEND_LATENCY (0)
+#define NAND_RESUME_LATENCY (0)
+#define NAND_MAX_SUSPENDS (0)
+#endif
+
+#ifndef NAND_ERASE_WEAR_STEP
+#define NAND_ERASE_WEAR_STEP (0) // 0: 마모와 무관하게 고정 지우기 시간
+#define NAND_ERASE_WEAR_PCENT (0)
+#define NAND_ERASE_WEAR_MAX_PCENT (0)
+#endif
+
+#ifndef NAND_READ_RETRY_MAX
+#define NAND_READ_RETRY_PE { 0 }
+#define NAND_READ_RETRY_NR_PE (0)
+#define NAND_READ_RETRY_AGE { 0 }
+#define NAND_READ_RETRY_NR_AGE (0)
+#define NAND_READ_RETRY_ECC_LATENCY (0)
+#define NAND_READ_RETRY_MAX (0) // 0: 재시도 없음
+#endif
+
 static const uint32_t ns_ssd_type[] = { NS_SSD_TYPE_0, NS_SSD_TYPE_1 };
 static const uint64_t ns_capacity[] = { NS_CAPACITY_0, NS_CAPACITY_1 };
 
@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# 동적 SLC 확장 확인: 장치를 꽉 채워 SLC를 줄인 뒤, 전체 트림 후 다시 쓰면
+# SLC가 다시 커져야 한다 (flush 통계의 grown > 0).
+# slc_buf=1 slc_dyn=1로 모듈을 로드한 뒤 실행 (fio, nvme-cli, blkdiscard 필요)
+# 사용법: ./slc_trim_rewrite.sh [DEV]
+
+DEV=${1:-/dev/nvme0n1}
+
+slc_stat() {
+    sudo nvme flush $DEV > /dev/null
+    sudo dmesg | grep "SLC Lines" | tail -1
+}
+
+echo "----------------------------------------"
+echo "1. 전체 순차 쓰기 (SLC 축소 유도)"
+sudo fio --name=fill --filename=$DEV --direct=1 --ioengine=libaio \
+    --rw=write --bs=128k --size=100% --iodepth=32 > /dev/null
+BEFORE=$(slc_stat)
+echo "   $BEFORE"
+
+echo "2. 전체 트림"
+sudo blkdiscard $DEV
+# 유휴 시간에 SLC 확장과 백그라운드 GC가 돌 수 있도록 잠시 대기
+sleep 5
+
+echo "3. 일부 다시 쓰기"
+sudo fio --name=rewrite --filename=$DEV --direct=1 --ioengine=libaio \
+    --rw=randwrite --bs=4k --size=20% --iodepth=32 --norandommap=1 > /dev/null
+AFTER=$(slc_stat)
+echo "   $AFTER"
+
+GROWN=$(echo "$AFTER" | sed -n 's/.*grown=\([0-9]*\).*/\1/p')
+echo "----------------------------------------"
+if [ -n "$GROWN" ] && [ "$GROWN" -gt 0 ]; then
+    echo "✅ SLC grown=$GROWN"
+else
+    echo "❌ SLC가 커지지 않음 (grown=${GROWN:-?})"
+    exit 1
+fi
@@ -0,0 +1,46 @@
+#!/bin/bash
+
+# 네임스페이스 범위를 벗어난 Write Zeroes가 LBA Out of Range로 실패하고
+# 커널 메모리를 건드리지 않는지 확인한다. (nvme-cli 필요, 모듈 로드 후 실행)
+# 사용법: ./write_zeroes_range.sh [DEV]
+
+DEV=${1:-/dev/nvme0n1}
+FAIL=0
+
+NSZE=$(sudo nvme id-ns $DEV | awk '/^nsze/ {print $3}')
+NSZE=$((NSZE))
+echo "----------------------------------------"
+echo "$DEV: nsze=$NSZE"
+
+# expect <성공해야 하면 0, 실패해야 하면 1> <slba> <nlb(0-based)>
+expect() {
+    sudo nvme write-zeroes $DEV --start-block=$2 --block-count=$3 > /dev/null 2>&1
+    RET=$?
+    [ $RET -ne 0 ] && GOT=1 || GOT=0
+    if [ $GOT -eq $1 ]; then
+        echo "✅ slba=$2 nlb=$3 -> ret=$RET"
+    else
+        echo "❌ slba=$2 nlb=$3 -> ret=$RET"
+        FAIL=1
+    fi
+}
+
+sudo dmesg -C
+
+expect 0 0 7                          # 정상 범위
+expect 0 $((NSZE - 8)) 7              # 마지막 8 LBA
+expect 1 $NSZE 0                      # 끝 바로 다음
+expect 1 $((NSZE - 4)) 7              # 끝을 걸침
+expect 1 $((NSZE * 2)) 65535          # 한참 바깥
+expect 1 $((0x0080000000000000)) 0    # 바이트 오프셋이 64비트를 넘는 SLBA
+
+# 잘못된 명령 이후에도 장치가 살아 있어야 한다
+expect 0 0 7
+
+if sudo dmesg | grep -qE "BUG:|Oops|general protection"; then
+    echo "❌ 커널 오류 발생 (dmesg 확인)"
+    FAIL=1
+fi
+
+echo "----------------------------------------"
+exit $FAIL
@@ -134,7 +134,7 @@ void zns_init_namespace(struct nvmev_ns *ns, uint32_t id, uint64_t size, void *m
 
 	ssd = kmalloc(sizeof(struct ssd), GFP_KERNEL);
 	ssd_init_params(&spp, size, nr_parts);
-	ssd_init(ssd, &spp, cpu_nr_dispatcher);
+	NVMEV_ASSERT(ssd && ssd_init(ssd, &spp, cpu_nr_dispatcher) == 0);
 
 	zns_ftl = kmalloc(sizeof(struct zns_ftl) * nr_parts, GFP_KERNEL);
 	zns_init_params(&zpp, &spp, size);